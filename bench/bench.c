@@ -0,0 +1,1081 @@
+// ============================================================================
+// File:        bench.c
+// Description: Host benchmarks of the math, model and lighting paths
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+// Built by `make bench` against the KOS stand-ins in bench/stub. Prints one
+// JSON object per line:
+//   {"name": ..., "iterations": ..., "ns_per_op": ..., "rate": ..., "unit": ...}
+// where rate is ops per second in the given unit. Every benchmark is run
+// BENCH_REPEATS times and the fastest run is reported. Usage:
+//   bench [-o frame.ppm] [substring]
+// runs the benchmarks whose name contains substring, all without it. With -o
+// the model is also drawn once by the software backend into frame.ppm.
+//   bench -c
+// runs the checks instead, one {"check": ..., "pass": ...} line each, and
+// exits with 1 if any fails. This is what `make check` does. One of them draws
+// the model with the software backend (into frame.ppm with -o) and compares
+// it to BENCH_GOLDEN. When a change to the picture is intended, update it with
+//   bench -o bench/golden/model_render_obj.ppm none
+// Host numbers don't predict SH4 timings, they are for spotting regressions.
+
+#include <kos.h>
+
+#include "config.h"
+#include "debug.h"
+#include "graphics.h"
+#include "model.h"
+#include "mv.h"
+#include "light.h"
+#include "mem.h"
+
+#include "obj_sscanf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_REPEATS   (5)
+#define BENCH_VERTICES  (4096)
+#define BENCH_RINGS     (64)  // Of the generated OBJ sphere, 16K triangles
+#define BENCH_SEGMENTS  (128)
+#define BENCH_ICO_SPLIT (16)  // Of the generated OBJ icosphere, 20 * 16^2 = 5120 triangles
+#define BENCH_GOLDEN    "bench/golden/model_render_obj.ppm" // Relative to the repository
+#define BENCH_TOLERANCE (8)   // Per channel, leaves room for other compilers' rounding
+#define BENCH_INSTANCES_X (8) // Grid of small copies of the model, the outer columns
+#define BENCH_INSTANCES_Y (4) // past the edges of the screen
+#define BENCH_INSTANCES (BENCH_INSTANCES_X * BENCH_INSTANCES_Y)
+
+typedef struct bench_t
+{
+    const char* name;
+    const char* unit;      // Of what one op is
+    size_t      iterations;
+    double      ops_per_iteration;
+    void      (*setup)(void);
+    void      (*run)(size_t iterations);
+    void      (*teardown)(void);
+} bench_t;
+
+static const char* filter;
+static const char* frame_path;
+static bool        checking;
+static char        obj_path[] = "/tmp/emotion_bench_XXXXXX";
+static double      obj_megabytes;
+static char        ico_path[] = "/tmp/emotion_bench_ico_XXXXXX";
+static double      ico_megabytes;
+static size_t      obj_triangles;
+static size_t      obj_drawn;     // Triangles submitted per frame, after culling
+
+static vec3_t      positions[BENCH_VERTICES];
+static vec3_t      normals[BENCH_VERTICES];
+static vec3_t      transformed[BENCH_VERTICES];
+static gfx_color_t colors[BENCH_VERTICES];
+static model_mid_t model = MODEL_ERROR;
+static mat4_t      instances[BENCH_INSTANCES];
+static light_lid_t directional = LIGHT_ERROR;
+
+volatile float bench_sink_f; // Keeps results alive
+volatile uint32_t bench_sink_u;
+
+// ============================================================================
+// Fixtures
+// ============================================================================
+
+static void set_camera(void)
+{
+    mv_set_matrix_model(MV_PROJECTION);
+    mv_identity();
+    mv_perspective_screen(CONFIG_SCREEN_W / 2.0f, CONFIG_SCREEN_H / 2.0f, 500.0f);
+    mv_set_matrix_model(MV_MODELVIEW);
+    mv_identity();
+    mv_scale(150.0f, 150.0f, 150.0f);
+    mv_translate(320.0f, 240.0f, 500.0f);
+    mv_calculate_transform();
+}
+
+static void set_lights(void)
+{
+    light_set_ambient((light_t){ .type = LIGHT_AMBIENT, .color = {0xFFFFFFFF}, .intensity = 0.1f });
+    light_set_point((light_t){ .type = LIGHT_POINT, .position = {320.0f, 200.0f, 800.0f},
+                               .color = {0xFFFFFFFF}, .intensity = 0.5f });
+}
+
+// Directional and ambient light only, which looks the same from every
+// instance, so they can share their lighting
+static void add_directional_light(void)
+{
+    light_set_point((light_t){ .type = LIGHT_POINT, .intensity = 0.0f });
+    directional = light_add((light_t){ .type = LIGHT_DIRECTIONAL, .direction = {0.3f, 0.5f, 1.0f},
+                                       .color = {0xFFFFFFFF}, .intensity = 0.8f });
+}
+
+static void remove_directional_light(void)
+{
+    light_remove(directional);
+    directional = LIGHT_ERROR;
+    set_lights();
+}
+
+// Uniformly scaled and translated copies, in the units of the model
+static void fill_instances(void)
+{
+    for(int y = 0; y < BENCH_INSTANCES_Y; y++) {
+        for(int x = 0; x < BENCH_INSTANCES_X; x++) {
+            mat4_t* m = &instances[y * BENCH_INSTANCES_X + x];
+
+            *m = (mat4_t){{0.0f}};
+            m->e[0] = m->e[5] = m->e[10] = 0.3f;
+            m->e[12] = (x - (BENCH_INSTANCES_X - 1) * 0.5f) * 0.7f;
+            m->e[13] = (y - (BENCH_INSTANCES_Y - 1) * 0.5f) * 0.7f;
+            m->e[14] = (float)((x + y) & 1) * 0.5f;
+            m->e[15] = 1.0f;
+        }
+    }
+}
+
+static void fill_vertices(void)
+{
+    for(size_t i = 0; i < BENCH_VERTICES; i++) {
+        float a = (float)i * 0.01f;
+        positions[i] = mv_vec_new(cosf(a), sinf(a * 0.7f), sinf(a));
+        normals[i]   = mv_vec_normalize(positions[i]);
+    }
+}
+
+static FILE* create_obj(char* path)
+{
+    int fd = mkstemp(path);
+
+    if(fd < 0) {
+        return NULL;
+    }
+
+    FILE* f = fdopen(fd, "w");
+
+    if(f == NULL) {
+        close(fd);
+    }
+
+    return f;
+}
+
+// A UV sphere written the way exporters do: v, vt and vn lines, then faces
+static bool write_obj(void)
+{
+    FILE* f = create_obj(obj_path);
+
+    if(f == NULL) {
+        return false;
+    }
+
+    for(int r = 0; r <= BENCH_RINGS; r++) {
+        float theta = MV_PI * r / BENCH_RINGS;
+
+        for(int s = 0; s <= BENCH_SEGMENTS; s++) {
+            float phi = MV_2PI * s / BENCH_SEGMENTS;
+            float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+
+            fprintf(f, "v %f %f %f\n", x, y, z);
+            fprintf(f, "vt %f %f\n", (float)s / BENCH_SEGMENTS, (float)r / BENCH_RINGS);
+            fprintf(f, "vn %f %f %f\n", x, y, z);
+        }
+    }
+
+    obj_triangles = 0;
+
+    for(int r = 0; r < BENCH_RINGS; r++) {
+        for(int s = 0; s < BENCH_SEGMENTS; s++) {
+            int a = r * (BENCH_SEGMENTS + 1) + s + 1;
+            int b = a + BENCH_SEGMENTS + 1;
+
+            fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+            obj_triangles += 2;
+        }
+    }
+
+    obj_megabytes = ftell(f) / 1e6;
+
+    return fclose(f) == 0;
+}
+
+// An icosphere, every face of an icosahedron split into BENCH_ICO_SPLIT^2
+// triangles. Vertices along the edges are repeated by each face using them.
+static bool write_ico(void)
+{
+    static const float t = 1.6180339f;
+    static const float corner[12][3] = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+        {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+    };
+    static const int face[20][3] = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11}, {1, 5, 9}, {5, 11, 4},
+        {11, 10, 2}, {10, 7, 6}, {7, 1, 8}, {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8},
+        {3, 8, 9}, {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+    };
+    const int n = BENCH_ICO_SPLIT;
+
+    FILE* f = create_obj(ico_path);
+
+    if(f == NULL) {
+        return false;
+    }
+
+    for(int k = 0; k < 20; k++) {
+        const float* a = corner[face[k][0]];
+        const float* b = corner[face[k][1]];
+        const float* c = corner[face[k][2]];
+
+        for(int i = 0; i <= n; i++) {
+            for(int j = 0; j <= n - i; j++) {
+                vec3_t p = mv_vec_normalize(mv_vec_new(a[0] + (b[0] - a[0]) * i / n + (c[0] - a[0]) * j / n,
+                                                       a[1] + (b[1] - a[1]) * i / n + (c[1] - a[1]) * j / n,
+                                                       a[2] + (b[2] - a[2]) * i / n + (c[2] - a[2]) * j / n));
+
+                fprintf(f, "v %f %f %f\n", p.x, p.y, p.z);
+                fprintf(f, "vt %f %f\n", 0.5f + atan2f(p.z, p.x) / MV_2PI, 0.5f - asinf(p.y) / MV_PI);
+                fprintf(f, "vn %f %f %f\n", p.x, p.y, p.z);
+            }
+        }
+    }
+
+    const int per_face = (n + 1) * (n + 2) / 2;
+
+    for(int k = 0; k < 20; k++) {
+        // 1-based index of grid point (i, j) of face k, rows of shrinking length
+        #define ICO_INDEX(i, j) (k * per_face + (i) * (n + 1) - (i) * ((i) - 1) / 2 + (j) + 1)
+
+        for(int i = 0; i < n; i++) {
+            for(int j = 0; j < n - i; j++) {
+                int p = ICO_INDEX(i, j), q = ICO_INDEX(i + 1, j), r = ICO_INDEX(i, j + 1);
+                fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", p, p, p, q, q, q, r, r, r);
+
+                if(j < n - i - 1) {
+                    int s = ICO_INDEX(i + 1, j + 1);
+                    fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", q, q, q, s, s, s, r, r, r);
+                }
+            }
+        }
+
+        #undef ICO_INDEX
+    }
+
+    ico_megabytes = ftell(f) / 1e6;
+
+    return fclose(f) == 0;
+}
+
+static void load_model(void)
+{
+    if((model = model_load_obj(obj_path, GFX_UNUSED, false)) == MODEL_ERROR) {
+        fprintf(stderr, "Failed to load the benchmark model\n");
+        exit(1);
+    }
+
+    set_camera();
+    set_lights();
+}
+
+static void free_model(void)
+{
+    model_free_obj(model);
+    model = MODEL_ERROR;
+}
+
+// ============================================================================
+// Benchmarks
+// ============================================================================
+
+static void run_matrix_multiply(size_t n)
+{
+    mv_set_matrix_model(MV_MODELVIEW);
+    mv_identity();
+
+    for(size_t i = 0; i < n; i++) {
+        mv_translate(1e-6f, 0.0f, 0.0f); // modelview = modelview * translation
+    }
+
+    bench_sink_f = mv_get_matrix(MV_MODELVIEW).e[12];
+}
+
+static void run_calculate_transform(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        mv_calculate_transform();
+    }
+
+    bench_sink_f = g_mv_transform.e[0];
+}
+
+static void run_mat_vec_transform(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        for(size_t j = 0; j < BENCH_VERTICES; j++) {
+            transformed[j] = mv_mat_vec_transform(positions[j]);
+        }
+    }
+
+    bench_sink_f = transformed[BENCH_VERTICES - 1].x;
+}
+
+static void run_transform_batch(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        mv_transform_batch(positions, transformed, BENCH_VERTICES);
+    }
+
+    bench_sink_f = transformed[BENCH_VERTICES - 1].x;
+}
+
+static void setup_lighting(void)
+{
+    set_camera();
+    set_lights();
+    light_prepare(mv_vec_new(0.0f, 0.0f, 0.0f), 2.0f);
+}
+
+static void run_light_calculate_color(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        for(size_t j = 0; j < BENCH_VERTICES; j++) {
+            colors[j] = light_calculate_color(positions[j], normals[j]);
+        }
+    }
+
+    bench_sink_u = colors[BENCH_VERTICES - 1].argb;
+}
+
+static void run_light_calculate_batch(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        light_calculate_batch(positions, normals, colors, BENCH_VERTICES);
+    }
+
+    bench_sink_u = colors[BENCH_VERTICES - 1].argb;
+}
+
+static void load_obj(const char* path, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        model_mid_t mid = model_load_obj(path, GFX_UNUSED, false);
+
+        if(mid == MODEL_ERROR) {
+            fprintf(stderr, "Failed to load the benchmark model %s\n", path);
+            exit(1);
+        }
+
+        model_free_obj(mid);
+    }
+}
+
+// The loader model_load_obj replaced, for comparison, see obj_sscanf.c
+static void load_obj_sscanf(const char* path, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        obj_sscanf_mesh_t m;
+
+        if(obj_sscanf_load(path, &m) == false) {
+            fprintf(stderr, "Failed to load the benchmark model %s\n", path);
+            exit(1);
+        }
+
+        bench_sink_u = (uint32_t)m.index_count;
+        obj_sscanf_free(&m);
+    }
+}
+
+static void run_model_load_obj_uvsphere(size_t n)  { load_obj(obj_path, n); }
+static void run_model_load_obj_icosphere(size_t n) { load_obj(ico_path, n); }
+static void run_obj_sscanf_uvsphere(size_t n)      { load_obj_sscanf(obj_path, n); }
+static void run_obj_sscanf_icosphere(size_t n)     { load_obj_sscanf(ico_path, n); }
+
+// The light cache makes every frame after the first skip lighting
+static void run_model_render_obj(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        gfx_begin();
+        model_render_obj(model);
+        gfx_end();
+    }
+}
+
+static void run_model_render_instances(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        gfx_begin();
+        model_render_instances(model, instances, BENCH_INSTANCES);
+        gfx_end();
+    }
+}
+
+static void load_model_directional(void)
+{
+    load_model();
+    add_directional_light();
+}
+
+static void free_model_directional(void)
+{
+    remove_directional_light();
+    free_model();
+}
+
+// A light that moves every frame, so every vertex is lit again
+static void run_model_render_obj_relit(size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        light_set_point((light_t){ .type = LIGHT_POINT, .position = {320.0f + (float)(i & 63), 200.0f, 800.0f},
+                                   .color = {0xFFFFFFFF}, .intensity = 0.5f });
+        gfx_begin();
+        model_render_obj(model);
+        gfx_end();
+    }
+}
+
+#ifdef CONFIG_GFX_BACKENDS
+static void use_null_backend(void)
+{
+    load_model();
+    gfx_set_backend(&gfx_backend_null);
+}
+
+static void use_soft_backend(void)
+{
+    load_model();
+    gfx_soft_set_output(NULL);
+    gfx_set_backend(&gfx_backend_soft);
+}
+
+static void use_pvr_backend(void)
+{
+    gfx_set_backend(&gfx_backend_pvr);
+    free_model();
+}
+#endif
+
+// What the render benchmarks count as faces, rather than every triangle of
+// the model: about half of them face away or are outside the frustum
+static size_t count_drawn(void)
+{
+#ifdef CONFIG_GFX_BACKENDS
+    use_null_backend();
+    gfx_null_reset_stats();
+    run_model_render_obj(1);
+    use_pvr_backend();
+
+    return gfx_null_get_stats().triangles;
+#else
+    return obj_triangles;
+#endif
+}
+
+// Draws the model once with the software backend into a PPM at path
+static bool write_frame(const char* path)
+{
+#ifndef CONFIG_GFX_BACKENDS
+    (void)path;
+    fprintf(stderr, "Writing frames needs CONFIG_GFX_BACKENDS\n");
+    return false;
+#else
+    load_model();
+    gfx_soft_set_output(path);
+    gfx_set_backend(&gfx_backend_soft);
+    run_model_render_obj(1);
+    use_pvr_backend();
+
+    FILE* f = fopen(path, "rb");
+
+    if(f == NULL) {
+        fprintf(stderr, "Failed to write the frame to %s\n", path);
+        return false;
+    }
+
+    fclose(f);
+    return true;
+#endif
+}
+
+// ============================================================================
+// Checks
+// ============================================================================
+
+static bool report_check(const char* name, bool pass, const char* measure, double value)
+{
+    printf("{\"check\": \"%s\", \"pass\": %s, \"%s\": %.3f}\n", name, pass ? "true" : "false", measure, value);
+    fflush(stdout);
+
+    return pass;
+}
+
+// A spot far above the model, aimed at it. SH sees it from the center and per
+// vertex lighting from every vertex, which this far out is the same direction,
+// so what is left is the SH approximation of the cosine lobe.
+static bool check_sh_spot(void)
+{
+    mv_set_matrix_model(MV_MODELVIEW);
+    mv_identity();
+    mv_calculate_transform();
+
+    // Only the spot, whatever the benchmarks left behind
+    light_set_ambient((light_t){ .type = LIGHT_AMBIENT, .intensity = 0.0f });
+    light_set_point((light_t){ .type = LIGHT_POINT, .intensity = 0.0f });
+
+    light_lid_t spot = light_add((light_t){ .type = LIGHT_SPOT, .position = {0.0f, 0.0f, 1000.0f},
+                                            .direction = {0.0f, 0.0f, -1.0f}, .color = {0xFFFFFFFF},
+                                            .intensity = 0.5f, .inner = 0.2f, .outer = 0.3f });
+    int max_error = 0;
+
+    for(size_t i = 0; i < BENCH_VERTICES; i++) {
+        gfx_color_t vertex, sh;
+
+        light_set_mode(LIGHT_MODE_VERTEX);
+        light_prepare(mv_vec_new(0.0f, 0.0f, 0.0f), 1.0f);
+        vertex = light_calculate_color(normals[i], normals[i]);
+
+        light_set_mode(LIGHT_MODE_SH);
+        light_prepare(mv_vec_new(0.0f, 0.0f, 0.0f), 1.0f);
+        sh = light_calculate_color(normals[i], normals[i]);
+
+        int error = abs((int)vertex.component.r - (int)sh.component.r);
+        if(error > max_error) max_error = error;
+    }
+
+    light_set_mode(LIGHT_MODE_VERTEX);
+    light_remove(spot);
+
+    // Order 2 SH is off by up to about 0.1 of the light, 0.5 here
+    return report_check("light_sh_spot", max_error <= 16, "max_error", max_error);
+}
+
+// The front and back of the model through the batch transform. Their depths
+// have to differ, the nearer one larger, for the PVR to sort them.
+static bool check_transform_depth(void)
+{
+    const vec3_t in[2] = {{0.0f, 0.0f, -1.0f}, {0.0f, 0.0f, 1.0f}}; // Eye z 350 and 650
+    vec3_t       out[2];
+
+    set_camera();
+    mv_transform_batch(in, out, 2);
+
+    return report_check("transform_depth", out[0].z > out[1].z, "depth_difference", out[0].z - out[1].z);
+}
+
+// Pixels of a P6 PPM as written by the software backend, NULL on failure
+static uint8_t* read_ppm(const char* path, int* width, int* height)
+{
+    FILE* f = fopen(path, "rb");
+
+    if(f == NULL) {
+        return NULL;
+    }
+
+    uint8_t* pixels = NULL;
+
+    if(fscanf(f, "P6 %d %d 255", width, height) == 2 && fgetc(f) == '\n') {
+        size_t size = (size_t)*width * *height * 3;
+
+        if((pixels = malloc(size)) != NULL && fread(pixels, 1, size, f) != size) {
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+
+    fclose(f);
+
+    return pixels;
+}
+
+// Pixels of two frames further apart than BENCH_TOLERANCE, -1 if either
+// couldn't be read or their sizes differ
+static long compare_frames(const char* a_path, const char* b_path)
+{
+    int      a_width, a_height, b_width, b_height;
+    uint8_t* a = read_ppm(a_path, &a_width, &a_height);
+    uint8_t* b = read_ppm(b_path, &b_width, &b_height);
+    long     differing = -1;
+
+    if(a != NULL && b != NULL && a_width == b_width && a_height == b_height) {
+        differing = 0;
+
+        for(long i = 0; i < (long)a_width * a_height; i++) {
+            for(int k = 0; k < 3; k++) {
+                if(abs((int)a[i * 3 + k] - (int)b[i * 3 + k]) > BENCH_TOLERANCE) {
+                    differing++;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(a);
+    free(b);
+
+    return differing;
+}
+
+// The model drawn by the software backend against the checked in frame
+static bool check_golden_frame(void)
+{
+    char        temp[] = "/tmp/emotion_frame_XXXXXX";
+    const char* path   = frame_path;
+
+    if(path == NULL) {
+        int fd = mkstemp(temp);
+
+        if(fd < 0) {
+            return report_check("golden_frame", false, "differing_pixels", -1);
+        }
+
+        close(fd);
+        path = temp;
+    }
+
+    long differing = write_frame(path) ? compare_frames(path, BENCH_GOLDEN) : -1;
+
+    if(differing < 0) {
+        fprintf(stderr, "Failed to compare the frame to %s\n", BENCH_GOLDEN);
+    }
+
+    if(path == temp) {
+        remove(temp);
+    }
+
+    return report_check("golden_frame", differing == 0, "differing_pixels", differing);
+}
+
+#ifdef CONFIG_GFX_BACKENDS
+// The instance grid, by model_render_instances or by one model_render_obj per
+// instance with the instance folded into the modelview. Those draw a freshly
+// loaded copy of the model each, so no cached lighting is carried over.
+static void draw_instances(bool instanced)
+{
+    gfx_begin();
+
+    if(instanced == true) {
+        model_render_instances(model, instances, BENCH_INSTANCES);
+    } else {
+        for(size_t i = 0; i < BENCH_INSTANCES; i++) {
+            const float* e = instances[i].e;
+
+            mv_identity();
+            mv_scale(150.0f * e[0], 150.0f * e[5], 150.0f * e[10]);
+            mv_translate(320.0f + 150.0f * e[12], 240.0f + 150.0f * e[13], 500.0f + 150.0f * e[14]);
+            mv_calculate_transform();
+
+            model_mid_t copy = model_load_obj(obj_path, GFX_UNUSED, false);
+            model_render_obj(copy);
+            model_free_obj(copy);
+        }
+
+        set_camera();
+    }
+
+    gfx_end();
+}
+
+// Draws both ways into a and b with the software backend
+static long compare_instances(const char* a, const char* b)
+{
+    gfx_set_backend(&gfx_backend_soft);
+    gfx_soft_set_output(a);
+    draw_instances(true);
+    gfx_soft_set_output(b);
+    draw_instances(false);
+
+    return compare_frames(a, b);
+}
+#endif
+
+// Instancing has to submit the same triangles and draw the same picture as
+// drawing every instance on its own, lit per instance by a point light in
+// front of them and shared between them by a directional one
+static bool check_instances(void)
+{
+#ifndef CONFIG_GFX_BACKENDS
+    return report_check("instances", true, "skipped", 0);
+#else
+    char a[] = "/tmp/emotion_frame_XXXXXX";
+    char b[] = "/tmp/emotion_frame_XXXXXX";
+    int  fd_a = mkstemp(a);
+    int  fd_b = mkstemp(b);
+
+    if(fd_a >= 0) close(fd_a);
+    if(fd_b >= 0) close(fd_b);
+
+    load_model();
+    light_set_point((light_t){ .type = LIGHT_POINT, .position = {200.0f, 150.0f, 200.0f},
+                               .color = {0xFFFFFFFF}, .intensity = 0.8f });
+
+    gfx_set_backend(&gfx_backend_null);
+    gfx_null_reset_stats();
+    draw_instances(true);
+    size_t instanced = gfx_null_get_stats().triangles;
+    gfx_null_reset_stats();
+    draw_instances(false);
+    size_t separate = gfx_null_get_stats().triangles;
+
+    long differing = -1;
+
+    if(fd_a >= 0 && fd_b >= 0) {
+        long point = compare_instances(a, b);
+        add_directional_light();
+        long shared = compare_instances(a, b);
+        remove_directional_light(); // Also puts the usual lights back
+
+        differing = (point < 0 || shared < 0) ? -1 : point + shared;
+    }
+
+    use_pvr_backend();
+    remove(a);
+    remove(b);
+
+    bool pass = report_check("instances_triangles", instanced == separate && instanced > 0, "triangles", instanced);
+
+    return report_check("instances_frame", differing == 0, "differing_pixels", differing) && pass;
+#endif
+}
+
+// Direct render has to send the TA the same bytes as the staging vertex and
+// pvr_prim, header for header and vertex for vertex
+static bool check_direct_render(void)
+{
+#ifndef CONFIG_GFX_BACKENDS
+    return report_check("direct_render", true, "skipped", 0);
+#else
+    load_model();
+
+    stub_sink_reset();
+    run_model_render_obj(1);
+    stub_sink_t direct = stub_sink;
+
+    gfx_set_direct_render(false);
+    stub_sink_reset();
+    run_model_render_obj(1);
+    stub_sink_t staging = stub_sink;
+    gfx_set_direct_render(true);
+
+    free_model();
+
+    bool same = direct.bytes == staging.bytes && direct.headers == staging.headers &&
+                direct.vertices == staging.vertices && direct.checksum == staging.checksum;
+
+    return report_check("direct_render", same && direct.vertices > 0, "bytes", direct.bytes);
+#endif
+}
+
+// Faces model_load_obj takes beyond plain triangles: a v//vn quad, a v/vt
+// pentagon by negative indices and without normals, and a bare v triangle.
+// OBJ_FIXTURE_PLAIN is the same mesh the way obj_sscanf reads it, fanned by
+// hand and with the smooth normals, which in this plane are all +z, written out.
+static const char OBJ_FIXTURE[] =
+    "v -1.0 0.0 0.0\nv -0.5 0.0 0.0\nv -0.5 0.5 0.0\nv -1.0 0.5 0.0\n"
+    "vn 0.0 0.0 1.0\n"
+    "f 1//1 2//1 3//1 4//1\n"
+    "v 0.0 0.0 0.0\nv 0.4 0.0 0.0\nv 0.5 0.3 0.0\nv 0.2 0.5 0.0\nv -0.1 0.3 0.0\n"
+    "vt 0.0 0.0\nvt 1.0 0.0\nvt 1.0 0.6\nvt 0.5 1.0\nvt 0.0 0.6\n"
+    "f -5/-5 -4/-4 -3/-3 -2/-2 -1/-1\n"
+    "f 5 6 9\n";
+
+static const char OBJ_FIXTURE_PLAIN[] =
+    "v -1.0 0.0 0.0\nv -0.5 0.0 0.0\nv -0.5 0.5 0.0\nv -1.0 0.5 0.0\n"
+    "v 0.0 0.0 0.0\nv 0.4 0.0 0.0\nv 0.5 0.3 0.0\nv 0.2 0.5 0.0\nv -0.1 0.3 0.0\n"
+    "vt 0.0 0.0\nvt 0.0 0.0\nvt 1.0 0.0\nvt 1.0 0.6\nvt 0.5 1.0\nvt 0.0 0.6\n"
+    "vn 0.0 0.0 1.0\n"
+    "f 1/1/1 2/1/1 3/1/1\nf 1/1/1 3/1/1 4/1/1\n"
+    "f 5/2/1 6/3/1 7/4/1\nf 5/2/1 7/4/1 8/5/1\nf 5/2/1 8/5/1 9/6/1\n"
+    "f 5/1/1 6/1/1 9/1/1\n";
+
+#define OBJ_FIXTURE_VERTICES  (12)
+#define OBJ_FIXTURE_TRIANGLES (6)
+
+static bool write_text(char* path, const char* text)
+{
+    FILE* f = create_obj(path);
+
+    if(f == NULL) {
+        return false;
+    }
+
+    bool written = fputs(text, f) >= 0;
+
+    return (fclose(f) == 0) && written;
+}
+
+// What the PVR is sent for a model, vertex colors and all
+static uint32_t draw_checksum(model_mid_t mid)
+{
+    set_camera();
+    stub_sink_reset();
+    gfx_begin();
+    model_render_obj(mid);
+    gfx_end();
+
+    return (stub_sink.vertices > 0) ? stub_sink.checksum : 0;
+}
+
+// Both fixtures have to give the same vertices and triangles, through
+// model_load_obj as through obj_sscanf, and be drawn and lit the same
+static bool check_obj_fixture(void)
+{
+    char fixture[] = "/tmp/emotion_fixture_XXXXXX";
+    char plain[]   = "/tmp/emotion_fixture_XXXXXX";
+
+    if(write_text(fixture, OBJ_FIXTURE) == false || write_text(plain, OBJ_FIXTURE_PLAIN) == false) {
+        return report_check("obj_fixture_counts", false, "vertices", -1);
+    }
+
+    model_mid_t       a = model_load_obj(fixture, GFX_UNUSED, false);
+    model_mid_t       b = model_load_obj(plain, GFX_UNUSED, false);
+    obj_sscanf_mesh_t s;
+    bool              scanned = obj_sscanf_load(plain, &s);
+
+    remove(fixture);
+    remove(plain);
+
+    const model_t* ma       = model_get(a);
+    const model_t* mb       = model_get(b);
+    double         vertices = (ma != NULL) ? (double)ma->vertex_count : -1;
+    bool           counted  = false;
+    bool           drawn    = false;
+
+    if(ma != NULL && mb != NULL && scanned) {
+        counted  = ma->vertex_count == OBJ_FIXTURE_VERTICES && ma->triangle_count == OBJ_FIXTURE_TRIANGLES &&
+                   mb->vertex_count == ma->vertex_count && mb->triangle_count == ma->triangle_count &&
+                   s.vertex_count == ma->vertex_count && s.index_count == 3 * ma->triangle_count;
+
+        set_lights();
+
+        uint32_t checksum = draw_checksum(a);
+        drawn = checksum != 0 && checksum == draw_checksum(b);
+    }
+
+    if(scanned) obj_sscanf_free(&s);
+    if(ma != NULL) model_free_obj(a);
+    if(mb != NULL) model_free_obj(b);
+
+    bool pass = report_check("obj_fixture_counts", counted, "vertices", vertices);
+
+    return report_check("obj_fixture_frame", drawn, "matching", drawn) && pass;
+}
+
+// Model space scale that gives a model's bounding sphere this projected
+// radius in pixels at the bench's camera distance
+static void set_projected_radius(const model_bounds_t* b, float radius)
+{
+    set_camera(); // Scales by 150, and the projected radius goes with the scale
+
+    float scale = 150.0f * radius / mv_projected_radius(b->center, b->radius);
+
+    mv_identity();
+    mv_scale(scale, scale, scale);
+    mv_translate(320.0f, 240.0f, 500.0f);
+    mv_calculate_transform();
+}
+
+// A model moving away and back again through the thresholds of a LOD group
+// has to switch levels, but only once it is past them by the hysteresis
+static bool check_lod(void)
+{
+#ifndef CONFIG_GFX_BACKENDS
+    return report_check("lod_levels", true, "skipped", 0);
+#else
+    static const float thresholds[2] = {100.0f, 40.0f};
+
+    // Projected radius, level drawn. The margin is CONFIG_MODEL_LOD_HYSTERESIS.
+    static const struct { float radius; size_t level; } steps[] = {
+        {150.0f, 0}, {95.0f, 0}, {85.0f, 1}, {105.0f, 1}, {115.0f, 0},
+        {30.0f, 2}, {42.0f, 2}, {46.0f, 1}, {150.0f, 0}
+    };
+
+    model_mid_t levels[3];
+
+    for(size_t i = 0; i < 3; i++) {
+        levels[i] = model_load_obj(obj_path, GFX_UNUSED, false);
+    }
+
+    model_mid_t    group = model_create_lod(levels, thresholds, 3);
+    const model_t* m     = model_get(group);
+    long           wrong = -1;
+
+    if(m != NULL) {
+        gfx_set_backend(&gfx_backend_null);
+        wrong = 0;
+
+        for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+            set_projected_radius(&m->bounds, steps[i].radius);
+
+            gfx_begin();
+            model_render_obj(group);
+            gfx_end();
+
+            if(m->lod.current != steps[i].level) {
+                wrong++;
+            }
+        }
+
+        use_pvr_backend();
+        model_free_obj(group);
+    } else {
+        for(size_t i = 0; i < 3; i++) {
+            if(levels[i] != MODEL_ERROR) model_free_obj(levels[i]);
+        }
+    }
+
+    return report_check("lod_levels", wrong == 0, "wrong_levels", wrong);
+#endif
+}
+
+static int run_checks(void)
+{
+    bool pass = true;
+
+    pass &= check_transform_depth();
+    pass &= check_sh_spot();
+    pass &= check_golden_frame();
+    pass &= check_instances();
+    pass &= check_direct_render();
+    pass &= check_obj_fixture();
+    pass &= check_lod();
+
+    return pass ? 0 : 1;
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+static void report(const char* name, size_t iterations, double ns_per_op, double rate, const char* unit)
+{
+    printf("{\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, \"rate\": %.1f, \"unit\": \"%s\"}\n",
+           name, iterations, ns_per_op, rate, unit);
+    fflush(stdout);
+}
+
+static void run(const bench_t* b)
+{
+    if(filter != NULL && strstr(b->name, filter) == NULL) {
+        return;
+    }
+
+    if(b->setup != NULL) b->setup();
+
+    b->run(1); // Warm up caches and the allocator
+
+    uint64_t best = UINT64_MAX;
+
+    for(int r = 0; r < BENCH_REPEATS; r++) {
+        uint64_t start = timer_ns_gettime64();
+        b->run(b->iterations);
+        uint64_t elapsed = timer_ns_gettime64() - start;
+
+        if(elapsed < best) best = elapsed;
+    }
+
+    if(b->teardown != NULL) b->teardown();
+
+    double ops       = (double)b->iterations * b->ops_per_iteration;
+    double ns_per_op = best / ops;
+
+    report(b->name, b->iterations, ns_per_op, 1e9 / ns_per_op, b->unit);
+}
+
+// Sink counts per frame, so changes in what is submitted show up next to the timings
+static void report_submission(void)
+{
+    if(filter != NULL && strstr("model_render_obj", filter) == NULL) {
+        return;
+    }
+
+    load_model();
+    stub_sink_reset();
+    run_model_render_obj(1);
+
+    printf("{\"name\": \"model_render_obj_sink\", \"triangles\": %zu, \"headers\": %zu, \"vertices\": %zu, \"bytes\": %zu}\n",
+           obj_triangles, stub_sink.headers, stub_sink.vertices, stub_sink.bytes);
+
+#ifdef CONFIG_GFX_BACKENDS
+    gfx_set_backend(&gfx_backend_null);
+    gfx_null_reset_stats();
+    run_model_render_obj(1);
+
+    gfx_null_stats_t n = gfx_null_get_stats();
+
+    printf("{\"name\": \"model_render_obj_null_stats\", \"headers\": %zu, \"texture_changes\": %zu, \"vertices\": %zu, \"strips\": %zu, \"triangles\": %zu}\n",
+           n.headers, n.texture_changes, n.vertices, n.strips, n.triangles);
+
+    use_pvr_backend();
+#else
+    free_model();
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            frame_path = argv[++i];
+        } else if(strcmp(argv[i], "-c") == 0) {
+            checking = true;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    // Without debug_begin the engine's log lines go nowhere, stdout stays JSON
+    gfx_initialize();
+    mem_initialize();
+    model_initialize();
+
+    fill_vertices();
+    fill_instances();
+
+    if(write_obj() == false || write_ico() == false) {
+        fprintf(stderr, "Failed to write the benchmark models to %s and %s\n", obj_path, ico_path);
+        return 1;
+    }
+
+    if(checking) {
+        int result = run_checks();
+        remove(obj_path);
+        remove(ico_path);
+        return result;
+    }
+
+    obj_drawn = count_drawn();
+
+    const bench_t benches[] = {
+        { "matrix_multiply",        "multiplies", 1000000, 1,              NULL,           run_matrix_multiply,        NULL },
+        { "mv_calculate_transform", "transforms", 200000,  1,              set_camera,     run_calculate_transform,    NULL },
+        { "mv_mat_vec_transform",   "vertices",   500,     BENCH_VERTICES, set_camera,     run_mat_vec_transform,      NULL },
+        { "mv_transform_batch",     "vertices",   500,     BENCH_VERTICES, set_camera,     run_transform_batch,        NULL },
+        { "light_calculate_color",  "vertices",   100,     BENCH_VERTICES, setup_lighting, run_light_calculate_color,  NULL },
+        { "light_calculate_batch",  "vertices",   100,     BENCH_VERTICES, setup_lighting, run_light_calculate_batch,  NULL },
+        { "model_load_obj_uvsphere", "MB",        5,       obj_megabytes,  NULL,           run_model_load_obj_uvsphere, NULL },
+        { "model_load_obj_sscanf_uvsphere", "MB",        5,       obj_megabytes,  NULL,           run_obj_sscanf_uvsphere,    NULL },
+        { "model_load_obj_icosphere", "MB",        10,      ico_megabytes,  NULL,           run_model_load_obj_icosphere, NULL },
+        { "model_load_obj_sscanf_icosphere", "MB",        10,      ico_megabytes,  NULL,           run_obj_sscanf_icosphere,   NULL },
+        { "model_render_obj",       "faces",      200,     obj_drawn,      load_model,     run_model_render_obj,       free_model },
+        { "model_render_obj_relit", "faces",      200,     obj_drawn,      load_model,     run_model_render_obj_relit, free_model },
+        { "model_render_instances", "instances",  20,      BENCH_INSTANCES, load_model,    run_model_render_instances, free_model },
+        { "model_render_instances_shared", "instances", 20, BENCH_INSTANCES, load_model_directional, run_model_render_instances, free_model_directional },
+#ifdef CONFIG_GFX_BACKENDS
+        { "model_render_obj_null",  "faces",      200,     obj_drawn,      use_null_backend, run_model_render_obj,     use_pvr_backend },
+        { "model_render_obj_soft",  "faces",      20,      obj_drawn,      use_soft_backend, run_model_render_obj,     use_pvr_backend },
+#endif
+    };
+
+    for(size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        run(&benches[i]);
+    }
+
+    report_submission();
+
+    bool written = (frame_path == NULL) || write_frame(frame_path);
+
+    remove(obj_path);
+    remove(ico_path);
+
+    return written ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+// ============================================================================
+// File:        obj_sscanf.c
+// Description: The sscanf based OBJ loader, as a benchmark baseline (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+// model_load_obj before the single pass parser: one pass to count, one to read
+// the attributes and one for the faces, a line at a time with fgets and
+// sscanf. It stops where that loader handed the mesh to model_create, which
+// model_load_obj still does on top, so the comparison flatters this one.
+
+#include "obj_sscanf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+typedef struct vertex_key_t
+{
+    int v, vt, vn;
+} vertex_key_t;
+
+typedef struct vertex_table_t
+{
+    uint32_t*     slots; // 1-based index into keys, 0 when empty
+    vertex_key_t* keys;
+    size_t        mask;
+    size_t        count;
+} vertex_table_t;
+
+static bool vertex_table_create(vertex_table_t* t, size_t max_keys)
+{
+    size_t slot_count = 64;
+
+    while(slot_count < max_keys * 2) {
+        slot_count *= 2;
+    }
+
+    t->slots = calloc(slot_count, sizeof(uint32_t));
+    t->keys  = malloc(sizeof(vertex_key_t) * (max_keys > 0 ? max_keys : 1));
+    t->mask  = slot_count - 1;
+    t->count = 0;
+
+    if(t->slots == NULL || t->keys == NULL) {
+        free(t->slots);
+        free(t->keys);
+        return false;
+    }
+
+    return true;
+}
+
+static void vertex_table_destroy(vertex_table_t* t)
+{
+    free(t->slots);
+    free(t->keys);
+}
+
+// Returns the vertex index for the key, or count if the key is new
+static size_t vertex_table_insert(vertex_table_t* t, vertex_key_t k)
+{
+    size_t h = ((k.v * 73856093u) ^ (k.vt * 19349663u) ^ (k.vn * 83492791u)) & t->mask;
+
+    while(t->slots[h] != 0) {
+        vertex_key_t* e = &t->keys[t->slots[h] - 1];
+        if(e->v == k.v && e->vt == k.vt && e->vn == k.vn) {
+            return t->slots[h] - 1;
+        }
+        h = (h + 1) & t->mask;
+    }
+
+    t->keys[t->count] = k;
+    t->slots[h] = (uint32_t)(t->count + 1);
+
+    return t->count++;
+}
+
+void obj_sscanf_free(obj_sscanf_mesh_t* m)
+{
+    free(m->vertices);
+    free(m->normals);
+    free(m->indices);
+
+    obj_sscanf_mesh_t empty = {0};
+    *m = empty;
+}
+
+bool obj_sscanf_load(const char* path, obj_sscanf_mesh_t* m)
+{
+    obj_sscanf_mesh_t empty = {0};
+    *m = empty;
+
+    FILE* f = fopen(path, "r");
+
+    if(f == NULL) {
+        return false;
+    }
+
+    size_t vertex_count = 0, uv_count = 0, normal_count = 0, face_count = 0;
+    char   line[256];
+
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == 'v' && isspace((int)line[1])) {
+            vertex_count++;
+        } else if(line[0] == 'v' && line[1] == 't') {
+            uv_count++;
+        } else if(line[0] == 'v' && line[1] == 'n') {
+            normal_count++;
+        } else if(line[0] == 'f') {
+            face_count++;
+        }
+    }
+
+    float* vertices = malloc(sizeof(float) * vertex_count * 3);
+    float* uv       = malloc(sizeof(float) * uv_count * 2);
+    float* normals  = malloc(sizeof(float) * normal_count * 3);
+
+    vertex_table_t table;
+    bool           valid = vertex_table_create(&table, face_count * 3);
+
+    m->vertices = malloc(sizeof(gfx_vertex_t) * face_count * 3);
+    m->normals  = malloc(sizeof(vec3_t) * face_count * 3);
+    m->indices  = malloc(sizeof(uint16_t) * face_count * 3);
+
+    if(vertices == NULL || uv == NULL || normals == NULL || valid == false ||
+       m->vertices == NULL || m->normals == NULL || m->indices == NULL) {
+        if(valid) vertex_table_destroy(&table);
+        free(vertices);
+        free(uv);
+        free(normals);
+        obj_sscanf_free(m);
+        fclose(f);
+        return false;
+    }
+
+    rewind(f);
+
+    size_t vertex_idx = 0, uv_idx = 0, normal_idx = 0;
+
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == 'v' && isspace((int)line[1])) {
+            sscanf(line, "v %f %f %f", &vertices[vertex_idx], &vertices[vertex_idx + 1], &vertices[vertex_idx + 2]);
+            vertex_idx += 3;
+        } else if(line[0] == 'v' && line[1] == 't') {
+            sscanf(line, "vt %f %f", &uv[uv_idx], &uv[uv_idx + 1]);
+            uv_idx += 2;
+        } else if(line[0] == 'v' && line[1] == 'n') {
+            sscanf(line, "vn %f %f %f", &normals[normal_idx], &normals[normal_idx + 1], &normals[normal_idx + 2]);
+            normal_idx += 3;
+        }
+    }
+
+    rewind(f);
+
+    while(valid && fgets(line, sizeof(line), f)) {
+        if(line[0] != 'f') {
+            continue;
+        }
+
+        int k[9];
+        if(sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d", &k[0], &k[1], &k[2],
+                                                        &k[3], &k[4], &k[5],
+                                                        &k[6], &k[7], &k[8]) != 9) {
+            valid = false;
+            break;
+        }
+
+        for(int corner = 0; corner < 3; corner++) {
+            vertex_key_t key = { k[3*corner], k[3*corner+1], k[3*corner+2] };
+
+            if(key.v  < 1 || (size_t)key.v  > vertex_count ||
+               key.vt < 1 || (size_t)key.vt > uv_count     ||
+               key.vn < 1 || (size_t)key.vn > normal_count) {
+                valid = false;
+                break;
+            }
+
+            size_t index = vertex_table_insert(&table, key);
+
+            if(index >= UINT16_MAX) {
+                valid = false;
+                break;
+            }
+
+            if(index == m->vertex_count) { // First use of this triple
+                gfx_vertex_t* v = &m->vertices[index];
+                v->color.argb = 0x00000000;
+                v->position.x = vertices[(3*(key.v-1))+0];
+                v->position.y = vertices[(3*(key.v-1))+1];
+                v->position.z = vertices[(3*(key.v-1))+2];
+                v->u = uv[(2*(key.vt-1))+0];
+                v->v = uv[(2*(key.vt-1))+1];
+                m->normals[index].x = normals[(3*(key.vn-1))+0];
+                m->normals[index].y = normals[(3*(key.vn-1))+1];
+                m->normals[index].z = normals[(3*(key.vn-1))+2];
+                m->vertex_count++;
+            }
+
+            m->indices[m->index_count++] = (uint16_t)index;
+        }
+    }
+
+    vertex_table_destroy(&table);
+    free(vertices);
+    free(uv);
+    free(normals);
+    fclose(f);
+
+    if(valid == false) {
+        obj_sscanf_free(m);
+    }
+
+    return valid;
+}
@@ -0,0 +1,31 @@
+// ============================================================================
+// File:        obj_sscanf.h
+// Description: The sscanf based OBJ loader, as a benchmark baseline (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#ifndef OBJ_SSCANF_H
+#define OBJ_SSCANF_H
+
+#include "graphics.h"
+#include "mv.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct obj_sscanf_mesh_t
+{
+    gfx_vertex_t* vertices; // One per unique v/vt/vn triple
+    vec3_t*       normals;
+    uint16_t*     indices;
+    size_t        vertex_count;
+    size_t        index_count;
+} obj_sscanf_mesh_t;
+
+// Only triangles with all of v/vt/vn, like the loader it stands in for
+bool obj_sscanf_load(const char* path, obj_sscanf_mesh_t* m);
+void obj_sscanf_free(obj_sscanf_mesh_t* m);
+
+#endif // OBJ_SSCANF_H
@@ -0,0 +1,17 @@
+// ============================================================================
+// File:        timer.h
+// Description: Host stand-in for KallistiOS arch/timer.h (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#ifndef STUB_ARCH_TIMER_H
+#define STUB_ARCH_TIMER_H
+
+#include <stdint.h>
+
+uint64_t timer_us_gettime64(void);
+uint64_t timer_ns_gettime64(void);
+
+
+#endif // STUB_ARCH_TIMER_H
@@ -0,0 +1,23 @@
+// ============================================================================
+// File:        fmath.h
+// Description: Host stand-in for KallistiOS dc/fmath.h (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+// Plain libm in place of the SH4 fsca/fsrra/fipr versions.
+
+#ifndef STUB_DC_FMATH_H
+#define STUB_DC_FMATH_H
+
+#include <math.h>
+
+#define fsqrt(x)  sqrtf(x)
+#define frsqrt(x) (1.0f / sqrtf(x))
+#define fsin(x)   sinf(x)
+#define fcos(x)   cosf(x)
+#define ftan(x)   tanf(x)
+
+#define fipr(x, y, z, w, a, b, c, d) ((x)*(a) + (y)*(b) + (z)*(c) + (w)*(d))
+
+
+#endif // STUB_DC_FMATH_H
@@ -0,0 +1,120 @@
+// ============================================================================
+// File:        pvr.h
+// Description: Host stand-in for KallistiOS dc/pvr.h (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+// Types keep the sizes the engine relies on (32 byte headers and vertices),
+// not the real register layouts.
+
+#ifndef STUB_DC_PVR_H
+#define STUB_DC_PVR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef void*    pvr_ptr_t;
+typedef uint32_t pvr_list_t;
+typedef uint32_t pvr_dr_state_t;
+
+#define PVR_LIST_OP_POLY        0
+#define PVR_LIST_TR_POLY        2
+
+#define PVR_CMD_POLYHDR         0x80000000
+#define PVR_CMD_VERTEX          0xe0000000
+#define PVR_CMD_VERTEX_EOL      0xf0000000
+
+#define PVR_TXRFMT_ARGB1555     (0 << 27)
+#define PVR_TXRFMT_RGB565       (1 << 27)
+#define PVR_TXRFMT_NONTWIDDLED  (1 << 26)
+#define PVR_FILTER_BILINEAR     2
+
+#define PVR_FOG_TABLE           0
+#define PVR_FOG_DISABLE         2
+
+#define PVR_BINSIZE_0           0
+#define PVR_BINSIZE_8           8
+#define PVR_BINSIZE_16          16
+#define PVR_BINSIZE_32          32
+
+typedef struct pvr_poly_hdr_t
+{
+    uint32_t cmd, mode1, mode2, mode3;
+    uint32_t d1, d2, d3, d4;
+} pvr_poly_hdr_t;
+
+typedef struct pvr_vertex_t
+{
+    uint32_t flags;
+    float    x, y, z;
+    float    u, v;
+    uint32_t argb, oargb;
+} pvr_vertex_t;
+
+typedef struct pvr_poly_cxt_t
+{
+    struct {
+        int fog_type;
+    } gen;
+    pvr_list_t list_type;
+    int        txr_enable;
+    int        txr_format;
+    int        txr_w, txr_h;
+    pvr_ptr_t  txr_base;
+} pvr_poly_cxt_t;
+
+typedef struct pvr_init_params_t
+{
+    int opb_sizes[5];
+    int vertex_buf_size;
+    int dma_enabled;
+    int fsaa_enabled;
+    int autosort_disabled;
+    int opb_overflow_count;
+} pvr_init_params_t;
+
+typedef struct pvr_stats_t
+{
+    uint32_t frame_last_time;
+    float    frame_rate;
+    uint32_t reg_last_time;
+    uint32_t rnd_last_time;
+    uint32_t vtx_buffer_used;
+    uint32_t vtx_buffer_used_max;
+} pvr_stats_t;
+
+int  pvr_init(pvr_init_params_t* params);
+int  pvr_init_defaults(void);
+int  pvr_get_stats(pvr_stats_t* stats);
+
+void pvr_wait_ready(void);
+void pvr_scene_begin(void);
+void pvr_scene_finish(void);
+int  pvr_list_begin(pvr_list_t list);
+int  pvr_list_finish(void);
+int  pvr_prim(void* data, int size);
+
+void pvr_poly_cxt_col(pvr_poly_cxt_t* dst, pvr_list_t list);
+void pvr_poly_cxt_txr(pvr_poly_cxt_t* dst, pvr_list_t list, int format, int w, int h, pvr_ptr_t base, int filter);
+void pvr_poly_compile(pvr_poly_hdr_t* dst, pvr_poly_cxt_t* src);
+
+pvr_ptr_t pvr_mem_malloc(size_t size);
+void      pvr_mem_free(pvr_ptr_t p);
+uint32_t  pvr_mem_available(void);
+
+void          pvr_dr_init(pvr_dr_state_t* state);
+pvr_vertex_t* pvr_dr_target_stub(pvr_dr_state_t* state);
+void          pvr_dr_commit(void* addr);
+#define pvr_dr_target(state) pvr_dr_target_stub(&(state))
+
+int   pvr_set_vertbuf(pvr_list_t list, void* buffer, int len);
+void* pvr_vertbuf_tail(pvr_list_t list);
+void  pvr_vertbuf_written(pvr_list_t list, size_t amount);
+
+void pvr_fog_table_color(float a, float r, float g, float b);
+void pvr_fog_table_linear(float start, float end);
+void pvr_fog_table_exp(float density);
+void pvr_fog_table_exp2(float density);
+
+
+#endif // STUB_DC_PVR_H
@@ -0,0 +1,62 @@
+// ============================================================================
+// File:        kos.h
+// Description: Host stand-in for the parts of KallistiOS used by src/ (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+// Just enough for the engine to build and run on Linux for benchmarking.
+// Nothing is drawn: everything submitted to the PVR ends up in a counting
+// sink, see stub_sink_t.
+
+#ifndef STUB_KOS_H
+#define STUB_KOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dc/pvr.h>
+#include <dc/fmath.h>
+#include <arch/timer.h>
+
+typedef uint32_t uint32;
+
+// Video
+#define DM_320x240 0
+#define DM_640x480 1
+#define PM_RGB565  0
+
+void vid_set_mode(int dm, int pm);
+
+// Maple
+#define MAPLE_FUNC_CONTROLLER 1
+
+typedef struct maple_device_t { int port; } maple_device_t;
+
+typedef struct cont_state_t
+{
+    uint32_t buttons;
+    int      ltrig, rtrig, joyx, joyy;
+} cont_state_t;
+
+maple_device_t* maple_enum_type(int n, uint32_t func);
+void*           maple_dev_status(maple_device_t* dev);
+
+// Everything the TA would have received
+typedef struct stub_sink_t
+{
+    size_t headers;
+    size_t vertices;
+    size_t bytes;
+    size_t scenes;
+    uint32_t checksum; // FNV-1a of every byte, in the order sent
+} stub_sink_t;
+
+extern stub_sink_t stub_sink;
+
+void stub_sink_reset(void);
+
+
+#endif // STUB_KOS_H
@@ -0,0 +1,254 @@
+// ============================================================================
+// File:        kos_stub.c
+// Description: Host stand-in for the parts of KallistiOS used by src/ (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#include <kos.h>
+
+#include <time.h>
+
+#define STUB_VRAM_SIZE (8 * 1024 * 1024)
+
+stub_sink_t stub_sink = {.checksum = 2166136261u};
+
+static size_t         vram_used;
+static pvr_vertex_t   dr_vertex[2];  // Store queue stand-ins, used in turn like SQ0 and SQ1
+static uint8_t*       vertbuf[4];
+static size_t         vertbuf_size[4];
+static size_t         vertbuf_written[4];
+
+void stub_sink_reset(void)
+{
+    memset(&stub_sink, 0, sizeof(stub_sink));
+    stub_sink.checksum = 2166136261u;
+}
+
+// Headers and vertices are told apart by the command in their first word
+static void sink(const void* data, size_t size)
+{
+    for(size_t i = 0; i + 32 <= size; i += 32) {
+        uint32_t cmd = *(const uint32_t*)((const uint8_t*)data + i);
+
+        if((cmd & 0xe0000000) == PVR_CMD_VERTEX) {
+            stub_sink.vertices++;
+        } else {
+            stub_sink.headers++;
+        }
+    }
+
+    for(size_t i = 0; i < size; i++) {
+        stub_sink.checksum = (stub_sink.checksum ^ ((const uint8_t*)data)[i]) * 16777619u;
+    }
+
+    stub_sink.bytes += size;
+}
+
+// ============================================================================
+// Timer, Video, Maple
+// ============================================================================
+
+uint64_t timer_ns_gettime64(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+uint64_t timer_us_gettime64(void)
+{
+    return timer_ns_gettime64() / 1000u;
+}
+
+void vid_set_mode(int dm, int pm)
+{
+    (void)dm;
+    (void)pm;
+}
+
+maple_device_t* maple_enum_type(int n, uint32_t func)
+{
+    static maple_device_t device;
+    (void)n;
+    (void)func;
+    return &device;
+}
+
+void* maple_dev_status(maple_device_t* dev)
+{
+    static cont_state_t state;
+    (void)dev;
+    return &state;
+}
+
+// ============================================================================
+// PVR
+// ============================================================================
+
+int pvr_init(pvr_init_params_t* params)
+{
+    (void)params;
+    return 0;
+}
+
+int pvr_init_defaults(void)
+{
+    return 0;
+}
+
+int pvr_get_stats(pvr_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->frame_rate = 60.0f;
+    return 0;
+}
+
+void pvr_wait_ready(void) {}
+
+void pvr_scene_begin(void)
+{
+    stub_sink.scenes++;
+
+    for(size_t i = 0; i < 4; i++) {
+        vertbuf_written[i] = 0;
+    }
+}
+
+void pvr_scene_finish(void) {}
+
+int pvr_list_begin(pvr_list_t list)
+{
+    (void)list;
+    return 0;
+}
+
+int pvr_list_finish(void)
+{
+    return 0;
+}
+
+int pvr_prim(void* data, int size)
+{
+    sink(data, (size_t)size);
+    return 0;
+}
+
+void pvr_poly_cxt_col(pvr_poly_cxt_t* dst, pvr_list_t list)
+{
+    memset(dst, 0, sizeof(*dst));
+    dst->list_type    = list;
+    dst->gen.fog_type = PVR_FOG_DISABLE;
+}
+
+void pvr_poly_cxt_txr(pvr_poly_cxt_t* dst, pvr_list_t list, int format, int w, int h, pvr_ptr_t base, int filter)
+{
+    (void)filter;
+    memset(dst, 0, sizeof(*dst));
+    dst->list_type    = list;
+    dst->txr_enable   = 1;
+    dst->txr_format   = format;
+    dst->txr_w        = w;
+    dst->txr_h        = h;
+    dst->txr_base     = base;
+    dst->gen.fog_type = PVR_FOG_DISABLE;
+}
+
+void pvr_poly_compile(pvr_poly_hdr_t* dst, pvr_poly_cxt_t* src)
+{
+    memset(dst, 0, sizeof(*dst));
+    dst->cmd   = PVR_CMD_POLYHDR | ((uint32_t)src->txr_enable << 3);
+    dst->mode1 = (uint32_t)src->gen.fog_type;
+    dst->mode2 = (uint32_t)src->txr_format;
+    dst->d1    = (uint32_t)(uintptr_t)src->txr_base;
+}
+
+// Backed by malloc, with the size of the real texture memory as the limit
+pvr_ptr_t pvr_mem_malloc(size_t size)
+{
+    if(vram_used + size > STUB_VRAM_SIZE) {
+        return NULL;
+    }
+
+    size_t* p = malloc(size + 32);
+
+    if(p == NULL) {
+        return NULL;
+    }
+
+    vram_used += size;
+    *p = size;
+
+    return (uint8_t*)p + 32;
+}
+
+void pvr_mem_free(pvr_ptr_t p)
+{
+    size_t* block = (size_t*)((uint8_t*)p - 32);
+
+    vram_used -= *block;
+    free(block);
+}
+
+uint32_t pvr_mem_available(void)
+{
+    return (uint32_t)(STUB_VRAM_SIZE - vram_used);
+}
+
+void pvr_dr_init(pvr_dr_state_t* state)
+{
+    *state = 0;
+}
+
+pvr_vertex_t* pvr_dr_target_stub(pvr_dr_state_t* state)
+{
+    return &dr_vertex[(*state)++ & 1];
+}
+
+void pvr_dr_commit(void* addr)
+{
+    sink(addr, 32);
+}
+
+int pvr_set_vertbuf(pvr_list_t list, void* buffer, int len)
+{
+    vertbuf[list]         = buffer;
+    vertbuf_size[list]    = (size_t)len;
+    vertbuf_written[list] = 0;
+    return 0;
+}
+
+void* pvr_vertbuf_tail(pvr_list_t list)
+{
+    return vertbuf[list] + vertbuf_written[list];
+}
+
+void pvr_vertbuf_written(pvr_list_t list, size_t amount)
+{
+    sink(vertbuf[list] + vertbuf_written[list], amount);
+    vertbuf_written[list] += amount;
+}
+
+void pvr_fog_table_color(float a, float r, float g, float b)
+{
+    (void)a;
+    (void)r;
+    (void)g;
+    (void)b;
+}
+
+void pvr_fog_table_linear(float start, float end)
+{
+    (void)start;
+    (void)end;
+}
+
+void pvr_fog_table_exp(float density)
+{
+    (void)density;
+}
+
+void pvr_fog_table_exp2(float density)
+{
+    (void)density;
+}
@@ -0,0 +1,162 @@
+// ============================================================================
+// File:        cluster.c
+// Description: Splitting meshes into culling clusters (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#define DEBUG_CHANNEL DEBUG_CHANNEL_MODEL
+
+#include "config.h"
+
+#include "cluster.h"
+
+#include "debug.h"
+#include "mem.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Clusters are grown breadth first over triangles that share a vertex, which
+// keeps them compact enough for a bounding sphere to be a useful fit. When a
+// connected piece runs out before the cluster is full, the next unassigned
+// triangle continues the same cluster.
+
+#define CLUSTER_MAX_VERTICES (65535) // Output indices are 16-bit
+
+bool cluster_build(const uint16_t* triangles, size_t triangle_count, size_t vertex_count,
+                   size_t max_triangles, cluster_list_t* out)
+{
+    memset(out, 0, sizeof(*out));
+
+    if(max_triangles == 0 || max_triangles > triangle_count) {
+        max_triangles = (triangle_count > 0) ? triangle_count : 1;
+    }
+
+    size_t max_clusters = (triangle_count + max_triangles - 1) / max_triangles + 1;
+
+    // Triangles around each vertex, as offsets into a single list
+    uint32_t* first    = mem_calloc(MEM_TAG_SCRATCH, vertex_count + 1, sizeof(uint32_t));
+    uint32_t* around   = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint32_t) * (triangle_count * 3 + 1));
+    uint32_t* queue    = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint32_t) * (triangle_count + 1));
+    uint32_t* order    = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint32_t) * (triangle_count + 1));
+    uint32_t* queued   = mem_calloc(MEM_TAG_SCRATCH, triangle_count + 1, sizeof(uint32_t)); // Last cluster that queued it
+    bool*     done     = mem_calloc(MEM_TAG_SCRATCH, triangle_count + 1, sizeof(bool));
+    uint32_t* stamp    = mem_calloc(MEM_TAG_SCRATCH, vertex_count + 1, sizeof(uint32_t));
+    uint16_t* remap    = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * (vertex_count + 1));
+
+    out->clusters   = mem_malloc(MEM_TAG_SCRATCH, sizeof(cluster_range_t) * max_clusters);
+    out->vertex_map = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * (triangle_count * 3 + 1));
+    out->indices    = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * (triangle_count * 3 + 1));
+
+    bool ok = (first != NULL && around != NULL && queue != NULL && order != NULL && queued != NULL && done != NULL &&
+               stamp != NULL && remap != NULL &&
+               out->clusters != NULL && out->vertex_map != NULL && out->indices != NULL);
+
+    if(ok == false) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate memory for clustering.\n");
+    } else {
+        for(size_t i = 0; i < triangle_count * 3; i++) {
+            first[triangles[i] + 1]++;
+        }
+        for(size_t v = 0; v < vertex_count; v++) {
+            first[v + 1] += first[v];
+        }
+        for(size_t i = 0; i < triangle_count * 3; i++) {
+            around[first[triangles[i]]++] = (uint32_t)(i / 3);
+        }
+        for(size_t v = vertex_count; v > 0; v--) {
+            first[v] = first[v - 1];
+        }
+        first[0] = 0;
+
+        // Order triangles cluster by cluster
+        size_t   assigned = 0;
+        size_t   seed     = 0;
+        uint32_t cluster  = 0;
+
+        while(ok == true && assigned < triangle_count) {
+            cluster++;
+
+            size_t start = assigned;
+            size_t head  = 0;
+            size_t tail  = 0;
+
+            while(assigned - start < max_triangles) {
+                if(head == tail) {
+                    while(seed < triangle_count && done[seed] == true) {
+                        seed++;
+                    }
+                    if(seed >= triangle_count) {
+                        break;
+                    }
+                    queued[seed]  = cluster;
+                    queue[tail++] = (uint32_t)seed;
+                }
+
+                uint32_t t = queue[head++];
+                order[assigned++] = t;
+                done[t]           = true;
+
+                for(int i = 0; i < 3; i++) {
+                    uint16_t v = triangles[3*t + i];
+                    for(uint32_t j = first[v]; j < first[v + 1]; j++) {
+                        if(done[around[j]] == false && queued[around[j]] != cluster) {
+                            queued[around[j]] = cluster;
+                            queue[tail++]     = around[j];
+                        }
+                    }
+                }
+            }
+
+            // Give the cluster its own vertices
+            cluster_range_t* r = &out->clusters[out->cluster_count++];
+
+            r->first_vertex   = (uint32_t)out->vertex_count;
+            r->first_triangle = (uint32_t)start;
+            r->triangle_count = (uint32_t)(assigned - start);
+
+            for(size_t i = start * 3; i < assigned * 3; i++) {
+                uint16_t v = triangles[3*order[i / 3] + i % 3];
+
+                if(stamp[v] != cluster) {
+                    if(out->vertex_count >= CLUSTER_MAX_VERTICES) {
+                        debug_printf(DEBUG_ERROR, "Clusters need more than %d vertices.\n", CLUSTER_MAX_VERTICES);
+                        ok = false;
+                        break;
+                    }
+                    stamp[v] = cluster;
+                    remap[v] = (uint16_t)out->vertex_count;
+                    out->vertex_map[out->vertex_count++] = v;
+                }
+
+                out->indices[i] = remap[v];
+            }
+
+            r->vertex_count = (uint32_t)(out->vertex_count - r->first_vertex);
+        }
+    }
+
+    mem_free(MEM_TAG_SCRATCH, first);
+    mem_free(MEM_TAG_SCRATCH, around);
+    mem_free(MEM_TAG_SCRATCH, queue);
+    mem_free(MEM_TAG_SCRATCH, order);
+    mem_free(MEM_TAG_SCRATCH, queued);
+    mem_free(MEM_TAG_SCRATCH, done);
+    mem_free(MEM_TAG_SCRATCH, stamp);
+    mem_free(MEM_TAG_SCRATCH, remap);
+
+    if(ok == false) {
+        cluster_free(out);
+    }
+
+    return ok;
+}
+
+void cluster_free(cluster_list_t* c)
+{
+    mem_free(MEM_TAG_SCRATCH, c->clusters);
+    mem_free(MEM_TAG_SCRATCH, c->vertex_map);
+    mem_free(MEM_TAG_SCRATCH, c->indices);
+    memset(c, 0, sizeof(*c));
+}
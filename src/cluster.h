@@ -0,0 +1,39 @@
+// ============================================================================
+// File:        cluster.h
+// Description: Splitting meshes into culling clusters (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct cluster_range_t
+{
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t first_triangle;
+    uint32_t triangle_count;
+} cluster_range_t;
+
+// Every cluster gets its own contiguous run of vertices, so vertices on the
+// border between clusters are duplicated. vertex_map gives the source vertex
+// of every output vertex, indices refer to output vertices.
+typedef struct cluster_list_t
+{
+    cluster_range_t* clusters;
+    uint16_t*        vertex_map;
+    uint16_t*        indices;       // Three per triangle, grouped by cluster
+    size_t           cluster_count;
+    size_t           vertex_count;
+} cluster_list_t;
+
+bool cluster_build(const uint16_t* triangles, size_t triangle_count, size_t vertex_count,
+                   size_t max_triangles, cluster_list_t* out);
+void cluster_free(cluster_list_t* c);
+
+#endif // CLUSTER_H
@@ -31,13 +31,45 @@
 
 #define CONFIG_DEBUG_DEFAULT_MODE DEBUG_STDOUT
 #define CONFIG_DEBUG_LOG_ENABLED
+#define CONFIG_DEBUG_LEVEL        DEBUG_LEVEL_TRACE // Less severe lines are compiled out, DEBUG_LEVEL_ERROR for release
 #define CONFIG_DEBUG_LOG_PATH     "/pc/debug.log"
+#define CONFIG_DEBUG_ASYNC                  // Format and write log lines on a background thread
+#define CONFIG_DEBUG_RING_SIZE    256       // Lines queued before new ones are dropped, power of two
+
+// Tracked allocations past these fail (and log a report), see mem.h
+#define CONFIG_MEM_BUDGET_RAM     (12 * 1024 * 1024)
+#define CONFIG_MEM_BUDGET_VRAM    0 // 0 for whatever is free after gfx_initialize, about 7 MiB
 
 #define CONFIG_MAX_TEXTURES       32
 #define CONFIG_MAX_MODELS         32
+#define CONFIG_MODEL_CLUSTER_SIZE 256 // Triangles per culling cluster
+#define CONFIG_MODEL_LOD_HYSTERESIS 0.1f // Fraction past a threshold before the level changes
+
+// Store model vertices as int16 positions, octahedral normals and int16 UVs
+// (12 bytes instead of 36). Decoding is folded into the vertex transform.
+//#define CONFIG_MODEL_QUANTIZED
 
 #define CONFIG_MATRIX_STACK_SIZE  32
 
+#define CONFIG_MAX_LIGHTS         8
+
+// Write vertices straight into the store queues instead of using pvr_prim
+#define CONFIG_GFX_DIRECT_RENDER
+
+// Build the scene in RAM and DMA it to the TA at the end of the frame, so the
+// CPU never waits on the TA. Takes precedence over direct render.
+//#define CONFIG_GFX_VERTEX_DMA
+#define CONFIG_GFX_VERTEX_BUFFER_SIZE (256 * 1024) // Per frame, double buffered
+
+// Let gfx_set_backend send frames to the null (counting) or software raster
+// backends instead of the PVR. Costs a branch per vertex on the PVR path, so
+// it is left to the host build (make bench defines it).
+//#define CONFIG_GFX_BACKENDS
+#define CONFIG_GFX_SOFT_OUTPUT    "/pc/frame_%04u.ppm" // Software backend frames, by frame number
+
+// Time subsystems per frame, see prof.h. Costs two timer reads per timed block.
+#define CONFIG_PROF_ENABLED
+#define CONFIG_PROF_FRAMES        60 // Frames of history for min/avg/max
 
 // ============================================================================
 // End Program Configuration
@@ -49,6 +81,10 @@
     #define INLINE static inline
 #endif
 
+#if defined(__SH4__) || defined(__SH4_SINGLE__) || defined(__SH4_SINGLE_ONLY__)
+    #define CONFIG_TARGET_SH4
+#endif
+
 #if   CONFIG_RESOLUTION == 240
     #define CONFIG_VIDEO_MODE DM_320x240
     #define CONFIG_SCREEN_W (320)
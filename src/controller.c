@@ -5,6 +5,7 @@
 // Date:        2023/12/04
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_INPUT
 
 #include "controller.h"
 #include "debug.h"
@@ -5,31 +5,460 @@
 // Date:        2023/12/06
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_CORE
+
 #include "config.h"
 
 #include "debug.h"
+#include "mem.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+
+#ifdef CONFIG_DEBUG_ASYNC
+    #ifdef CONFIG_TARGET_SH4
+        #include <kos.h>
+    #else
+        #include <pthread.h>
+        #include <time.h>
+    #endif
+#endif
 
 static FILE* debug_log;
 static uint8_t debug_mode;
 
 #ifdef CONFIG_DEBUG_LOG_ENABLED
 
+uint8_t debug_level    = DEBUG_LEVEL_TRACE;
+uint8_t debug_channels = DEBUG_CHANNEL_ALL;
+
+static void debug_write(const char* header, const char* text)
+{
+    if(debug_mode & DEBUG_STDOUT) {
+        fputs(header, stdout);
+        fputs(text, stdout);
+    }
+
+    if((debug_mode & DEBUG_FILE) && debug_log != NULL) {
+        fputs(header, debug_log);
+        fputs(text, debug_log);
+    }
+}
+
+static void write_formatted(const char* header, const char* fmt, va_list args)
+{
+    char line[512];
+
+    vsnprintf(line, sizeof(line), fmt, args);
+
+    debug_write(header, line);
+}
+
+#ifdef CONFIG_DEBUG_ASYNC
+
+// ============================================================================
+// Asynchronous Logging
+// ============================================================================
+// debug_output only copies the format pointer and the raw arguments into a
+// ring buffer, strings being copied in as they may not outlive the call. The
+// argument types come from the call site's debug_format_t, so the format is
+// only scanned on a call site's first line. A
+// background thread formats and writes the entries. There is a single
+// producer (the thread logging) and a single consumer, so the
+// indices only need ordered loads and stores. Lines that don't fit in the
+// ring are dropped and counted.
+
+#define DEBUG_TEXT_SIZE  (64) // Bytes for copies of string arguments, per entry
+#define DEBUG_LINE_SIZE  (512)
+#define DEBUG_SPEC_SIZE  (32)
+#define DEBUG_IDLE_MS    (5)
+
+typedef union debug_arg_t
+{
+    int         i;
+    long        l;
+    long long   ll;
+    double      d;
+    const void* p;
+    size_t      text; // Offset of a copied string in debug_entry_t.text
+} debug_arg_t;
+
+typedef struct debug_entry_t
+{
+    const char* header;
+    const char* fmt;
+    debug_arg_t args[DEBUG_MAX_ARGS];
+    char        text[DEBUG_TEXT_SIZE];
+} debug_entry_t;
+
+typedef enum debug_arg_type_t
+{
+    DEBUG_ARG_NONE, DEBUG_ARG_INT, DEBUG_ARG_LONG, DEBUG_ARG_LLONG,
+    DEBUG_ARG_DOUBLE, DEBUG_ARG_PTR, DEBUG_ARG_STRING
+} debug_arg_type_t;
+
+static debug_entry_t* ring;        // NULL while there is no logging thread, lines are written directly
+static uint32_t      ring_head;    // Next entry written, only advanced by the producer
+static uint32_t      ring_tail;    // Next entry read, only advanced by the consumer
+static uint32_t      ring_dropped;
+static bool          ring_running;
+
+#ifdef CONFIG_TARGET_SH4
+static kthread_t*    ring_thread;
+#else
+static pthread_t     ring_thread;
+#endif
+
+// Parses the conversion at fmt (just past the '%'). Returns the type of the
+// argument it takes and sets *end past it. *stars counts '*' widths and
+// precisions, which take an int each before the argument.
+static debug_arg_type_t parse_conversion(const char* fmt, const char** end, int* stars)
+{
+    int longs = 0;
+
+    *stars = 0;
+
+    while(*fmt != '\0' && strchr("-+ #0", *fmt) != NULL) fmt++;
+    if(*fmt == '*') { (*stars)++; fmt++; }
+    while(*fmt >= '0' && *fmt <= '9') fmt++;
+    if(*fmt == '.') {
+        fmt++;
+        if(*fmt == '*') { (*stars)++; fmt++; }
+        while(*fmt >= '0' && *fmt <= '9') fmt++;
+    }
+
+    for(; *fmt != '\0' && strchr("hlzjtL", *fmt) != NULL; fmt++) {
+        if(*fmt == 'l') longs++;
+        if(*fmt == 'z' || *fmt == 'j' || *fmt == 't') longs = (sizeof(size_t) == sizeof(long)) ? 1 : 0;
+    }
+
+    *end = (*fmt != '\0') ? fmt + 1 : fmt;
+
+    switch(*fmt) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        return (longs >= 2) ? DEBUG_ARG_LLONG : (longs == 1) ? DEBUG_ARG_LONG : DEBUG_ARG_INT;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        return DEBUG_ARG_DOUBLE;
+    case 'p':
+        return DEBUG_ARG_PTR;
+    case 's':
+        return DEBUG_ARG_STRING;
+    default:
+        return DEBUG_ARG_NONE; // %% or malformed
+    }
+}
+
+// Fills in the argument types of fmt, '*' widths and precisions as ints
+static void compile_format(debug_format_t* format, const char* fmt)
+{
+    size_t n = 0;
+
+    for(const char* p = strchr(fmt, '%'); p != NULL && n < DEBUG_MAX_ARGS; p = strchr(p, '%')) {
+        int              stars;
+        debug_arg_type_t type = parse_conversion(p + 1, &p, &stars);
+
+        for(; stars > 0 && n < DEBUG_MAX_ARGS; stars--) {
+            format->types[n++] = DEBUG_ARG_INT;
+        }
+
+        if(type != DEBUG_ARG_NONE && n < DEBUG_MAX_ARGS) {
+            format->types[n++] = (uint8_t)type;
+        }
+    }
+
+    format->count = (uint8_t)n;
+    format->fmt   = fmt;
+}
+
+void debug_output(debug_format_t* format, const char* header, const char* fmt, ...)
+{
+    va_list args;
+
+    if(ring == NULL) {
+        va_start(args, fmt);
+        write_formatted(header, fmt, args);
+        va_end(args);
+        return;
+    }
+
+    uint32_t head = ring_head;
+
+    if(head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) >= CONFIG_DEBUG_RING_SIZE) {
+        __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // A call site passing different formats just recompiles
+    if(format->fmt != fmt) {
+        compile_format(format, fmt);
+    }
+
+    debug_entry_t* e    = &ring[head % CONFIG_DEBUG_RING_SIZE];
+    size_t         used = 0;
+
+    e->header = header;
+    e->fmt    = fmt;
+
+    va_start(args, fmt);
+
+    for(size_t n = 0; n < format->count; n++) {
+        switch(format->types[n]) {
+        case DEBUG_ARG_INT:    e->args[n].i  = va_arg(args, int);         break;
+        case DEBUG_ARG_LONG:   e->args[n].l  = va_arg(args, long);        break;
+        case DEBUG_ARG_LLONG:  e->args[n].ll = va_arg(args, long long);   break;
+        case DEBUG_ARG_DOUBLE: e->args[n].d  = va_arg(args, double);      break;
+        case DEBUG_ARG_PTR:    e->args[n].p  = va_arg(args, const void*); break;
+        case DEBUG_ARG_STRING: {
+            const char* s = va_arg(args, const char*);
+            if(s == NULL) s = "(null)";
+
+            // Truncated to whatever room is left, always terminated
+            size_t room = DEBUG_TEXT_SIZE - used;
+            size_t l    = strlen(s);
+            if(l >= room) l = room - 1;
+
+            memcpy(&e->text[used], s, l);
+            e->text[used + l] = '\0';
+            e->args[n].text = used;
+            used += l + (used + l + 1 < DEBUG_TEXT_SIZE ? 1 : 0);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    va_end(args);
+
+    __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Formats an entry the same way printf would have
+static void format_entry(const debug_entry_t* e, char* out, size_t size)
+{
+    const char* fmt  = e->fmt;
+    size_t      n    = 0;
+    size_t      used = 0;
+
+    while(*fmt != '\0' && used + 1 < size) {
+        if(*fmt != '%') {
+            out[used++] = *fmt++;
+            continue;
+        }
+
+        const char*      end;
+        int              stars;
+        debug_arg_type_t type   = parse_conversion(fmt + 1, &end, &stars);
+        size_t           length = (size_t)(end - fmt);
+
+        if(type == DEBUG_ARG_NONE && end[-1] == '%') {
+            out[used++] = '%';
+            fmt = end;
+            continue;
+        }
+
+        // Conversions past the captured arguments are printed as they are
+        if(length >= DEBUG_SPEC_SIZE || n + stars + (type != DEBUG_ARG_NONE) > DEBUG_MAX_ARGS) {
+            while(fmt < end && used + 1 < size) out[used++] = *fmt++;
+            continue;
+        }
+
+        // Copy of the conversion, with '*' replaced by the captured numbers
+        char spec[DEBUG_SPEC_SIZE * 2];
+        size_t s = 0;
+        for(const char* c = fmt; c < end; c++) {
+            if(*c == '*') {
+                s += (size_t)snprintf(&spec[s], sizeof(spec) - s, "%d", e->args[n++].i);
+            } else {
+                spec[s++] = *c;
+            }
+        }
+        spec[s] = '\0';
+
+        char*  dst  = &out[used];
+        size_t room = size - used;
+        int    w    = 0;
+
+        switch(type) {
+        case DEBUG_ARG_INT:    w = snprintf(dst, room, spec, e->args[n++].i);            break;
+        case DEBUG_ARG_LONG:   w = snprintf(dst, room, spec, e->args[n++].l);            break;
+        case DEBUG_ARG_LLONG:  w = snprintf(dst, room, spec, e->args[n++].ll);           break;
+        case DEBUG_ARG_DOUBLE: w = snprintf(dst, room, spec, e->args[n++].d);            break;
+        case DEBUG_ARG_PTR:    w = snprintf(dst, room, spec, e->args[n++].p);            break;
+        case DEBUG_ARG_STRING: w = snprintf(dst, room, spec, &e->text[e->args[n++].text]); break;
+        default:               w = snprintf(dst, room, "%s", spec);                      break;
+        }
+
+        if(w > 0) {
+            used += ((size_t)w < room) ? (size_t)w : room - 1;
+        }
+
+        fmt = end;
+    }
+
+    out[used] = '\0';
+}
+
+static void ring_sleep(void)
+{
+#ifdef CONFIG_TARGET_SH4
+    thd_sleep(DEBUG_IDLE_MS);
+#else
+    struct timespec t = {0, DEBUG_IDLE_MS * 1000000L};
+    nanosleep(&t, NULL);
+#endif
+}
+
+// Writes out everything in the ring, returns whether there was anything
+static bool ring_drain(void)
+{
+    uint32_t tail = ring_tail;
+    uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    char     line[DEBUG_LINE_SIZE];
+
+    for(; tail != head; tail++) {
+        const debug_entry_t* e = &ring[tail % CONFIG_DEBUG_RING_SIZE];
+
+        format_entry(e, line, sizeof(line));
+        debug_write(e->header, line);
+
+        __atomic_store_n(&ring_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    uint32_t dropped = __atomic_exchange_n(&ring_dropped, 0, __ATOMIC_RELAXED);
+
+    if(dropped > 0) {
+        snprintf(line, sizeof(line), "Log buffer full, dropped %u lines.\n", (unsigned)dropped);
+        debug_write("[ERROR] ", line);
+    }
+
+    if(tail != ring_head || dropped > 0) {
+        fflush(stdout);
+        if(debug_log != NULL) fflush(debug_log);
+        return true;
+    }
+
+    return false;
+}
+
+static void* ring_thread_main(void* unused)
+{
+    (void)unused;
+
+    while(__atomic_load_n(&ring_running, __ATOMIC_ACQUIRE) == true) {
+        if(ring_drain() == false) {
+            ring_sleep();
+        }
+    }
+
+    ring_drain();
+
+    return NULL;
+}
+
+static bool ring_start(void)
+{
+    if((ring = mem_malloc(MEM_TAG_LOG, sizeof(debug_entry_t) * CONFIG_DEBUG_RING_SIZE)) == NULL) {
+        return false;
+    }
+
+    __atomic_store_n(&ring_running, true, __ATOMIC_RELEASE);
+
+#ifdef CONFIG_TARGET_SH4
+    // Lower priority than the game, so it writes while the game waits on the PVR
+    if((ring_thread = thd_create(0, ring_thread_main, NULL)) != NULL) {
+        thd_set_prio(ring_thread, PRIO_DEFAULT + 1);
+        return true;
+    }
+#else
+    if(pthread_create(&ring_thread, NULL, ring_thread_main, NULL) == 0) {
+        return true;
+    }
+#endif
+
+    ring_running = false;
+    mem_free(MEM_TAG_LOG, ring);
+    ring = NULL;
+    return false;
+}
+
+static void ring_stop(void)
+{
+    if(ring == NULL) {
+        return;
+    }
+
+    // The thread drains the ring before it exits
+    __atomic_store_n(&ring_running, false, __ATOMIC_RELEASE);
+
+#ifdef CONFIG_TARGET_SH4
+    thd_join(ring_thread, NULL);
+    ring_thread = NULL;
+#else
+    pthread_join(ring_thread, NULL);
+#endif
+
+    mem_free(MEM_TAG_LOG, ring);
+    ring = NULL;
+}
+
+void debug_flush(void)
+{
+    if(ring == NULL) {
+        fflush(stdout);
+        if(debug_log != NULL) fflush(debug_log);
+        return;
+    }
+
+    while(__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) != ring_head) {
+        ring_sleep();
+    }
+}
+
+#else
+
+void debug_output(debug_format_t* format, const char* header, const char* fmt, ...)
+{
+    va_list args;
+
+    (void)format;
+
+    va_start(args, fmt);
+    write_formatted(header, fmt, args);
+    va_end(args);
+}
+
+void debug_flush(void)
+{
+    fflush(stdout);
+    if(debug_log != NULL) fflush(debug_log);
+}
+
+#endif // CONFIG_DEBUG_ASYNC
+
 bool debug_begin(uint8_t mode)
 {
     debug_mode = mode;
-    
+
     printf("\nEmotion by Shirobon ::: Version %s ::: Built on: %s %s\n\n", CONFIG_VERSION, __DATE__, __TIME__);
-    
+
     if(debug_mode & DEBUG_FILE) {
         if((debug_log = fopen(CONFIG_DEBUG_LOG_PATH, "w")) == NULL) {
             printf("[ERROR] Failed to open debug log: %s\n", CONFIG_DEBUG_LOG_PATH);
             return false;
         }
         fprintf(debug_log, "Emotion by Shirobon ::: Version %s ::: Built on: %s %s\n\n", CONFIG_VERSION, __DATE__, __TIME__);
+    }
+
+#ifdef CONFIG_DEBUG_ASYNC
+    if(ring_start() == false) {
+        printf("[ERROR] Failed to start logging thread, logging synchronously.\n");
+    }
+#endif
+
+    if(debug_log != NULL) {
         debug_printf(DEBUG_INFO, "Opened %s for debug logging.\n", CONFIG_DEBUG_LOG_PATH);
     }
 
@@ -38,29 +467,28 @@ bool debug_begin(uint8_t mode)
     return true;
 }
 
-void debug_printf(const char* header, const char* fmt, ...)
+void debug_set_level(uint8_t level)
 {
-    va_list argptr;
-
-    if(debug_mode & DEBUG_STDOUT) {
-        va_start(argptr, fmt);
-        fprintf(stdout, header);
-        vfprintf(stdout, fmt, argptr);
-        va_end(argptr);
-    }
+    debug_level = level;
+}
 
-    if(debug_mode & DEBUG_FILE) {
-        va_start(argptr, fmt);
-        fprintf(debug_log, header);
-        vfprintf(debug_log, fmt, argptr);
-        va_end(argptr);
-    }
+void debug_set_channels(uint8_t channels)
+{
+    debug_channels = channels;
 }
 
 void debug_end(void)
 {
     debug_printf(DEBUG_INFO, "Ending debug log.\n");
-    fclose(debug_log);
+
+#ifdef CONFIG_DEBUG_ASYNC
+    ring_stop();
+#endif
+
+    if(debug_log != NULL) {
+        fclose(debug_log);
+        debug_log = NULL;
+    }
 }
 
 #endif // CONFIG_DEBUG_LOG_ENABLED
@@ -16,19 +16,90 @@
 #define DEBUG_STDOUT  0x1
 #define DEBUG_FILE    0x2
 
-#define DEBUG_ERROR   "[ERROR] "
-#define DEBUG_INFO    "[INFO]  "
-#define DEBUG_BLANK   "        "
-#define DEBUG_NONE    ""
+// Severity, lower is more severe
+#define DEBUG_LEVEL_ERROR   0
+#define DEBUG_LEVEL_WARN    1
+#define DEBUG_LEVEL_INFO    2
+#define DEBUG_LEVEL_TRACE   3
+
+// Each source file sets its channel before including anything, e.g.
+// #define DEBUG_CHANNEL DEBUG_CHANNEL_GFX
+#define DEBUG_CHANNEL_CORE  0x01
+#define DEBUG_CHANNEL_GFX   0x02
+#define DEBUG_CHANNEL_MODEL 0x04
+#define DEBUG_CHANNEL_MV    0x08
+#define DEBUG_CHANNEL_LIGHT 0x10
+#define DEBUG_CHANNEL_INPUT 0x20
+#define DEBUG_CHANNEL_MEM   0x40
+#define DEBUG_CHANNEL_ALL   0xFF
+
+#ifndef DEBUG_CHANNEL
+    #define DEBUG_CHANNEL DEBUG_CHANNEL_CORE
+#endif
+
+// Level and line header. DEBUG_BLANK continues the previous line, so it is
+// logged at INFO, and should only follow INFO or more severe lines.
+#define DEBUG_ERROR   DEBUG_LEVEL_ERROR, "[ERROR] "
+#define DEBUG_WARN    DEBUG_LEVEL_WARN,  "[WARN]  "
+#define DEBUG_INFO    DEBUG_LEVEL_INFO,  "[INFO]  "
+#define DEBUG_TRACE   DEBUG_LEVEL_TRACE, "[TRACE] "
+#define DEBUG_BLANK   DEBUG_LEVEL_INFO,  "        "
+#define DEBUG_NONE    DEBUG_LEVEL_INFO,  ""
 
 bool debug_begin(uint8_t mode);
-void debug_printf(const char* header, const char* fmt, ...);
 void debug_end(void);
 
+// Runtime filter, on top of CONFIG_DEBUG_LEVEL. Defaults to everything.
+void debug_set_level(uint8_t level);
+void debug_set_channels(uint8_t channels);
+
+// Blocks until everything queued so far has been written
+void debug_flush(void);
+
+// Argument types of a format string, worked out on the first call from each
+// debug_printf and kept there, so later calls only copy the arguments
+#define DEBUG_MAX_ARGS (8)
+
+typedef struct debug_format_t
+{
+    const char* fmt;   // What types describes, NULL until the first call
+    uint8_t     count;
+    uint8_t     types[DEBUG_MAX_ARGS];
+} debug_format_t;
+
+// Use debug_printf(DEBUG_INFO, fmt, ...). Lines above CONFIG_DEBUG_LEVEL are
+// compiled out, arguments included, and filtered lines don't format anything.
+// With CONFIG_DEBUG_ASYNC the line is queued and written later by a logging
+// thread. Only one thread may log. Strings are copied (up to 64 bytes per
+// line in total), other arguments are kept as values, at most 8 of them.
+void debug_output(debug_format_t* format, const char* header, const char* fmt, ...);
+
+extern uint8_t debug_level;
+extern uint8_t debug_channels;
+
+INLINE bool debug_enabled(uint8_t channel, uint8_t level)
+{
+    return level <= debug_level && (debug_channels & channel) != 0;
+}
+
+#define debug_printf(...) DEBUG_PRINTF_(DEBUG_CHANNEL, __VA_ARGS__)
+#define DEBUG_PRINTF_(...) DEBUG_PRINTF__(__VA_ARGS__)
+#define DEBUG_PRINTF__(channel, level, header, ...) \
+    do { \
+        if((level) <= CONFIG_DEBUG_LEVEL && debug_enabled(channel, level)) { \
+            static debug_format_t debug_format_; \
+            debug_output(&debug_format_, header, __VA_ARGS__); \
+        } \
+    } while(0)
+
 #ifndef CONFIG_DEBUG_LOG_ENABLED
     #define debug_begin(x)
-    #define debug_printf(x, y, ...)
     #define debug_end()
+    #define debug_set_level(x)
+    #define debug_set_channels(x)
+    #define debug_flush()
+    #undef  debug_printf
+    #define debug_printf(...)
 #endif
 
 
@@ -5,24 +5,226 @@
 // Date:        2023/12/05
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_GFX
+
 #include "config.h"
 
 #include "graphics.h"
 
 #include "debug.h"
+#include "prof.h"
+#include "mem.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <string.h>
 #include <kos.h>
 
 static gfx_texture_t texture[CONFIG_MAX_TEXTURES];
 static bool          texture_occupied[CONFIG_MAX_TEXTURES];
 static size_t        texture_count;
-static size_t        texture_memory;
 static size_t        vertex_count;
 static size_t        vertex_memory;
+static size_t        vertex_memory_peak;
+
+// Polygon headers are compiled once (per texture at load, see gfx_texture_t)
+// and only sent when the render state differs from the previous primitive's.
+#define GFX_STATE_NONE              (0)
+#define GFX_STATE_COLOR             (1)
+#define GFX_STATE_FMT_RGB565        (0)
+#define GFX_STATE_FMT_ARGB1555      (1)
+#define GFX_STATE_TEXTURE(tid, fmt) ((((uint32_t)(tid) + 1) << 2) | (fmt))
+#define GFX_STATE_TID(state)        ((gfx_tid_t)(((state) >> 2) - 1))
+#define GFX_STATE_FMT(state)        ((state) & 3)
+
+static pvr_poly_hdr_t color_hdr;
+static uint32_t       current_state;
+
+static bool           fog_enabled; // Compiled into the headers, so they are redone on change
+
+#ifdef CONFIG_GFX_BACKENDS
+static const gfx_backend_t* backend = &gfx_backend_pvr;
+#endif
+
+// ============================================================================
+// Submission - Everything sent to the TA goes through these
+// ============================================================================
+// With CONFIG_GFX_VERTEX_DMA, the scene is built in a RAM vertex buffer which
+// is DMA'd to the TA at gfx_end, so the CPU doesn't wait on the TA. With
+// CONFIG_GFX_DIRECT_RENDER, vertices are written straight into the store
+// queues and flushed to the TA with pref (on the host, into the stubbed ones).
+// Otherwise they are filled into a staging vertex which is then copied out
+// with pvr_prim. Host builds keep the staging path next to direct render, so
+// the two can be compared, see gfx_set_direct_render.
+
+#if defined(CONFIG_GFX_VERTEX_DMA)
+    #define GFX_SUBMIT_DMA
+#elif defined(CONFIG_GFX_DIRECT_RENDER)
+    #define GFX_SUBMIT_DR
+#endif
+
+#if defined(GFX_SUBMIT_DMA)
+// Split in two by KOS, one half is filled while the other is being sent
+static uint8_t      vertbuf[2 * CONFIG_GFX_VERTEX_BUFFER_SIZE] __attribute__((aligned(32)));
+static uint8_t*     vertbuf_start;
+static uint8_t*     vertbuf_cursor;
+static uint8_t*     vertbuf_end;
+static size_t       vertbuf_dropped; // Vertices of primitives that didn't fit, this frame
+#elif defined(GFX_SUBMIT_DR)
+static pvr_dr_state_t dr_state;
+#endif
+
+#if !defined(GFX_SUBMIT_DR) || defined(CONFIG_GFX_BACKENDS)
+static pvr_vertex_t   staging __attribute__((aligned(32)));
+#endif
+
+#if defined(GFX_SUBMIT_DR) && defined(CONFIG_GFX_BACKENDS)
+static bool           direct_render = true;
+#endif
+
+// Whether a primitive of this many vertices, and a header before it, fits the
+// vertex buffer. Checked once per primitive, so the TA is never sent a strip
+// cut off before its end of strip vertex.
+INLINE bool submit_reserve(size_t count)
+{
+#if defined(GFX_SUBMIT_DMA)
+    #ifdef CONFIG_GFX_BACKENDS
+    if(backend != &gfx_backend_pvr) {
+        return true;
+    }
+    #endif
+
+    if((size_t)(vertbuf_end - vertbuf_cursor) < (count + 1) * sizeof(pvr_vertex_t)) {
+        vertbuf_dropped += count;
+        return false;
+    }
+#else
+    (void)count;
+#endif
+
+    return true;
+}
+
+INLINE void* submit_target(void)
+{
+#if defined(GFX_SUBMIT_DMA)
+    return vertbuf_cursor;
+#elif defined(GFX_SUBMIT_DR)
+    #ifdef CONFIG_GFX_BACKENDS
+    if(!direct_render) {
+        return &staging;
+    }
+    #endif
+
+    return pvr_dr_target(dr_state);
+#else
+    return &staging;
+#endif
+}
+
+INLINE void submit_commit(void* p)
+{
+#if defined(GFX_SUBMIT_DMA)
+    (void)p;
+    vertbuf_cursor += sizeof(pvr_vertex_t);
+#elif defined(GFX_SUBMIT_DR)
+    #ifdef CONFIG_GFX_BACKENDS
+    if(!direct_render) {
+        pvr_prim(p, sizeof(pvr_vertex_t));
+        return;
+    }
+    #endif
+
+    pvr_dr_commit(p);
+#else
+    pvr_prim(p, sizeof(pvr_vertex_t));
+#endif
+}
+
+INLINE void submit_vertex(uint32_t flags, const gfx_vertex_t* p)
+{
+#ifdef CONFIG_GFX_BACKENDS
+    if(backend != &gfx_backend_pvr) {
+        backend->vertex(p, flags == PVR_CMD_VERTEX_EOL);
+        return;
+    }
+#endif
+
+    pvr_vertex_t* v = (pvr_vertex_t*)submit_target();
+
+    v->flags = flags;
+    v->x     = p->position.x;
+    v->y     = p->position.y;
+    v->z     = p->position.z;
+    v->u     = p->u; // Ignored by the TA for untextured polygons
+    v->v     = p->v;
+    v->argb  = p->color.argb;
+    v->oargb = 0;
+
+    submit_commit(v);
+}
+
+static void submit_header(uint32_t state, const pvr_poly_hdr_t* hdr)
+{
+    if(state == current_state) {
+        return;
+    }
+
+    current_state = state;
+    vertex_memory += sizeof(*hdr);
+
+#ifdef CONFIG_GFX_BACKENDS
+    if(backend != &gfx_backend_pvr) {
+        const gfx_texture_t* t = (state == GFX_STATE_COLOR) ? NULL : &texture[GFX_STATE_TID(state)];
+        backend->state(t, GFX_STATE_FMT(state) == GFX_STATE_FMT_ARGB1555);
+        return;
+    }
+#endif
+
+    // Word copies, the store queues can't take byte writes
+    uint32_t*       dst = (uint32_t*)submit_target();
+    const uint32_t* src = (const uint32_t*)hdr;
+
+    for(size_t i = 0; i < sizeof(pvr_poly_hdr_t) / sizeof(uint32_t); i++) {
+        dst[i] = src[i];
+    }
+
+    submit_commit(dst);
+}
+
+static void compile_color_header(void)
+{
+    pvr_poly_cxt_t cxt;
+
+    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
+    cxt.gen.fog_type = fog_enabled ? PVR_FOG_TABLE : PVR_FOG_DISABLE;
+    pvr_poly_compile(&color_hdr, &cxt);
+}
+
+// The ARGB1555 header is only used by the font, which stays clear of fog
+static void compile_texture_headers(gfx_texture_t* t)
+{
+    pvr_poly_cxt_t cxt;
+
+    pvr_poly_cxt_txr(&cxt,  PVR_LIST_OP_POLY,
+                            PVR_TXRFMT_RGB565 | PVR_TXRFMT_NONTWIDDLED,
+                            t->width,
+                            t->height,
+                            t->pvr_memory,
+                            PVR_FILTER_BILINEAR);
+    cxt.gen.fog_type = fog_enabled ? PVR_FOG_TABLE : PVR_FOG_DISABLE;
+    pvr_poly_compile(&t->hdr_rgb565, &cxt);
+
+    pvr_poly_cxt_txr(&cxt,  PVR_LIST_OP_POLY,
+                            PVR_TXRFMT_ARGB1555 | PVR_TXRFMT_NONTWIDDLED,
+                            t->width,
+                            t->height,
+                            t->pvr_memory,
+                            PVR_FILTER_BILINEAR);
+    pvr_poly_compile(&t->hdr_argb1555, &cxt);
+}
 
 
 void gfx_initialize(void)
@@ -34,35 +236,145 @@ void gfx_initialize(void)
     }
     
     texture_count   = 0;
-    texture_memory  = 0;
     vertex_count    = 0;
     vertex_memory   = 0;
+    vertex_memory_peak = 0;
 
     debug_printf(DEBUG_INFO, "Initialized texture manager.\n");
     debug_printf(DEBUG_BLANK,"Texture limit: %d\n", CONFIG_MAX_TEXTURES);
 
     vid_set_mode(CONFIG_VIDEO_MODE, PM_RGB565);
+
+#ifdef GFX_SUBMIT_DMA
+    // Same lists and bin sizes as pvr_init_defaults, plus vertex DMA
+    pvr_init_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.opb_sizes[PVR_LIST_OP_POLY] = PVR_BINSIZE_16;
+    params.opb_sizes[PVR_LIST_TR_POLY] = PVR_BINSIZE_16;
+    params.vertex_buf_size             = 512 * 1024;
+    params.dma_enabled                 = 1;
+    pvr_init(&params);
+
+    pvr_set_vertbuf(PVR_LIST_OP_POLY, vertbuf, sizeof(vertbuf));
+
+    debug_printf(DEBUG_INFO, "Enabled vertex DMA.\n");
+    debug_printf(DEBUG_BLANK,"Vertex buffer: %.1f KiB per frame\n", CONFIG_GFX_VERTEX_BUFFER_SIZE/1024.0f);
+#else
     pvr_init_defaults();
+#endif
+
+    fog_enabled = false;
+    compile_color_header();
 
     debug_printf(DEBUG_INFO, "Initialized video at %dx%d.\n", CONFIG_SCREEN_W, CONFIG_SCREEN_H);
 }
 
+static void pvr_begin(void)
+{
+    PROF_SCOPE(PROF_WAIT) {
+        pvr_wait_ready();
+    }
+    pvr_scene_begin();
+
+#if defined(GFX_SUBMIT_DMA)
+    vertbuf_start   = (uint8_t*)pvr_vertbuf_tail(PVR_LIST_OP_POLY);
+    vertbuf_cursor  = vertbuf_start;
+    vertbuf_end     = vertbuf_start + CONFIG_GFX_VERTEX_BUFFER_SIZE;
+    vertbuf_dropped = 0;
+#else
+    pvr_list_begin(PVR_LIST_OP_POLY);
+    #ifdef GFX_SUBMIT_DR
+    pvr_dr_init(&dr_state);
+    #endif
+#endif
+}
+
+static void pvr_end(void)
+{
+#if defined(GFX_SUBMIT_DMA)
+    size_t written = vertbuf_cursor - vertbuf_start;
+
+    #ifdef CONFIG_TARGET_SH4
+    dcache_flush_range((uintptr_t)vertbuf_start, written); // DMA reads RAM, not the cache
+    #endif
+
+    pvr_vertbuf_written(PVR_LIST_OP_POLY, written);
+
+    if(vertbuf_dropped > 0) {
+        debug_printf(DEBUG_WARN, "Vertex buffer full, dropped %d vertices.\n", (int)vertbuf_dropped);
+    }
+#else
+    pvr_list_finish();
+#endif
+
+    pvr_scene_finish();
+}
+
 void gfx_begin(void)
 {
     vertex_count  = 0;
     vertex_memory = 0;
+    current_state = GFX_STATE_NONE;
 
-    pvr_wait_ready();
-    pvr_scene_begin();
-    pvr_list_begin(PVR_LIST_OP_POLY);
+#ifdef CONFIG_GFX_BACKENDS
+    backend->begin();
+#else
+    pvr_begin();
+#endif
 }
 
 void gfx_end(void)
 {
-    pvr_list_finish();
-    pvr_scene_finish();
+#ifdef CONFIG_GFX_BACKENDS
+    backend->end();
+#else
+    pvr_end();
+#endif
+
+    if(vertex_memory > vertex_memory_peak) {
+        vertex_memory_peak = vertex_memory;
+    }
+}
+
+#ifdef CONFIG_GFX_BACKENDS
+
+const gfx_backend_t gfx_backend_pvr = {
+    "PVR", NULL, NULL, pvr_begin, pvr_end, NULL, NULL
+};
+
+void gfx_set_backend(const gfx_backend_t* b)
+{
+    if(b == backend) {
+        return;
+    }
+
+    if(backend->close != NULL) backend->close();
+
+    backend = b;
+
+    if(backend->open != NULL) backend->open();
+
+    current_state = GFX_STATE_NONE;
+
+    debug_printf(DEBUG_INFO, "Graphics backend: %s\n", backend->name);
+}
+
+const gfx_backend_t* gfx_get_backend(void)
+{
+    return backend;
 }
 
+void gfx_set_direct_render(bool enabled)
+{
+#ifdef GFX_SUBMIT_DR
+    direct_render = enabled;
+#else
+    (void)enabled;
+#endif
+}
+
+#endif // CONFIG_GFX_BACKENDS
+
 gfx_tid_t gfx_load_texture(const char* asset, size_t width, size_t height)
 {
     if(texture_count >= CONFIG_MAX_TEXTURES) {
@@ -79,15 +391,16 @@ gfx_tid_t gfx_load_texture(const char* asset, size_t width, size_t height)
         return GFX_ERROR;
     }
 
-    if((ptx = pvr_mem_malloc(size)) == NULL) {
+    if((ptx = mem_pvr_malloc(MEM_TAG_TEXTURE, size)) == NULL) {
         debug_printf(DEBUG_ERROR, "Failed to allocate PVR memory for texture.\n");
+        fclose(f);
         return GFX_ERROR;
     }
 
     if(fread(ptx, 1, size, f) != size) {
         debug_printf(DEBUG_ERROR, "Failed to read texture from: %s\n", asset);
         fclose(f);
-        pvr_mem_free(ptx);
+        mem_pvr_free(MEM_TAG_TEXTURE, ptx, size);
         return GFX_ERROR;
     }
 
@@ -104,7 +417,6 @@ gfx_tid_t gfx_load_texture(const char* asset, size_t width, size_t height)
     texture_occupied[tid] = true;
 
     texture_count++;
-    texture_memory += size;
 
     texture[tid].asset      = (char*)asset;
     texture[tid].pvr_memory = ptx;
@@ -113,12 +425,17 @@ gfx_tid_t gfx_load_texture(const char* asset, size_t width, size_t height)
     texture[tid].size       = size;
     texture[tid].tid        = tid;
 
+    compile_texture_headers(&texture[tid]);
+
+    // A new texture may reuse the id of one drawn earlier in this list
+    current_state = GFX_STATE_NONE;
+
     debug_printf(DEBUG_INFO, "Loaded PVR texture (tid = %d)\n", tid);
     debug_printf(DEBUG_BLANK,"Asset: %s\n", asset);
     debug_printf(DEBUG_BLANK,"Size:  %dx%d\n", width, height);
     
     debug_printf(DEBUG_INFO, "Active textures: %d\n", texture_count);
-    debug_printf(DEBUG_BLANK, "Texture memory used: %.1f KiB\n", texture_memory/1024.0f);
+    debug_printf(DEBUG_BLANK, "Texture memory used: %.1f KiB\n", mem_get_usage(MEM_TAG_TEXTURE, MEM_POOL_VRAM).current/1024.0f);
 
     return tid;
 }
@@ -130,163 +447,152 @@ void gfx_free_texture(gfx_tid_t tid)
         return;
     }
 
-    pvr_mem_free(texture[tid].pvr_memory);
+    mem_pvr_free(MEM_TAG_TEXTURE, texture[tid].pvr_memory, texture[tid].size);
 
     texture_count--;
-    texture_memory -= texture[tid].size;
     texture_occupied[tid] = false;
 
     debug_printf(DEBUG_INFO, "Freed PVR texture (tid = %d)\n", tid);
     debug_printf(DEBUG_INFO, "Active textures: %d\n", texture_count);
-    debug_printf(DEBUG_BLANK,"Texture memory used: %.1f KiB\n", texture_memory/1024.0f);
+    debug_printf(DEBUG_BLANK,"Texture memory used: %.1f KiB\n", mem_get_usage(MEM_TAG_TEXTURE, MEM_POOL_VRAM).current/1024.0f);
+}
+
+// ============================================================================
+// Fog - Depth cueing by the PVR fog table, at no cost per vertex
+// ============================================================================
+
+static void set_fog_enabled(bool enabled)
+{
+    if(enabled == fog_enabled) {
+        return;
+    }
+
+    fog_enabled = enabled;
+
+    compile_color_header();
+
+    for(size_t i = 0; i < CONFIG_MAX_TEXTURES; i++) {
+        if(texture_occupied[i] == true) {
+            compile_texture_headers(&texture[i]);
+        }
+    }
+
+    // The header in effect may have been compiled with the old setting
+    current_state = GFX_STATE_NONE;
+
+    debug_printf(DEBUG_INFO, "Fog %s.\n", enabled ? "enabled" : "disabled");
+}
+
+static void set_fog_color(gfx_color_t color)
+{
+    pvr_fog_table_color(color.component.a / 255.0f, color.component.r / 255.0f,
+                        color.component.g / 255.0f, color.component.b / 255.0f);
+}
+
+void gfx_set_fog_linear(float start, float end, gfx_color_t color)
+{
+    set_fog_color(color);
+    pvr_fog_table_linear(start, end);
+    set_fog_enabled(true);
+}
+
+void gfx_set_fog_exp(float density, gfx_color_t color)
+{
+    set_fog_color(color);
+    pvr_fog_table_exp(density);
+    set_fog_enabled(true);
+}
+
+void gfx_set_fog_exp2(float density, gfx_color_t color)
+{
+    set_fog_color(color);
+    pvr_fog_table_exp2(density);
+    set_fog_enabled(true);
+}
+
+void gfx_disable_fog(void)
+{
+    set_fog_enabled(false);
 }
 
 void gfx_draw_op_tri(gfx_vertex_t va, gfx_vertex_t vb, gfx_vertex_t vc)
 {
-    pvr_poly_hdr_t hdr;
-    pvr_poly_cxt_t cxt;
-    pvr_vertex_t   v;
+    if(submit_reserve(3) == false) {
+        return;
+    }
 
-    pvr_poly_cxt_col(&cxt, PVR_LIST_OP_POLY);
-    pvr_poly_compile(&hdr, &cxt);
-    pvr_prim(&hdr, sizeof(hdr));
-
-    v.flags = PVR_CMD_VERTEX;
-    v.x = va.position.x;
-    v.y = va.position.y;
-    v.z = va.position.z;
-    v.u = 0.0f;
-    v.v = 0.0f;
-    v.argb = va.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
-
-    v.flags = PVR_CMD_VERTEX;
-    v.x = vb.position.x;
-    v.y = vb.position.y;
-    v.z = vb.position.z;
-    v.u = 0.0f;
-    v.v = 0.0f;
-    v.argb = vb.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
-
-    v.flags = PVR_CMD_VERTEX_EOL;
-    v.x = vc.position.x;
-    v.y = vc.position.y;
-    v.z = vc.position.z;
-    v.u = 0.0f;
-    v.v = 0.0f;
-    v.argb = vc.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
+    submit_header(GFX_STATE_COLOR, &color_hdr);
+
+    submit_vertex(PVR_CMD_VERTEX,     &va);
+    submit_vertex(PVR_CMD_VERTEX,     &vb);
+    submit_vertex(PVR_CMD_VERTEX_EOL, &vc);
 
     vertex_count  += 3;
-    vertex_memory += sizeof(hdr) + 3*sizeof(v);
+    vertex_memory += 3*sizeof(pvr_vertex_t);
 }
 
 void gfx_draw_op_tex_tri(gfx_vertex_t va, gfx_vertex_t vb, gfx_vertex_t vc, gfx_tid_t tid)
 {
-    pvr_poly_hdr_t hdr;
-    pvr_poly_cxt_t cxt;
-    pvr_vertex_t   v;
-    gfx_texture_t  txr;
+    if(submit_reserve(3) == false) {
+        return;
+    }
 
-    txr = texture[tid];
+    submit_header(GFX_STATE_TEXTURE(tid, GFX_STATE_FMT_RGB565), &texture[tid].hdr_rgb565);
 
-    pvr_poly_cxt_txr(&cxt,  PVR_LIST_OP_POLY,
-                            PVR_TXRFMT_RGB565 | PVR_TXRFMT_NONTWIDDLED,
-                            txr.width,
-                            txr.height,
-                            txr.pvr_memory,
-                            PVR_FILTER_BILINEAR);
-    pvr_poly_compile(&hdr, &cxt);
-    pvr_prim(&hdr, sizeof(hdr));
-
-    v.flags = PVR_CMD_VERTEX;
-    v.x = va.position.x;
-    v.y = va.position.y;
-    v.z = va.position.z;
-    v.u = va.u;
-    v.v = va.v;
-    v.argb = va.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
-
-    v.flags = PVR_CMD_VERTEX;
-    v.x = vb.position.x;
-    v.y = vb.position.y;
-    v.z = vb.position.z;
-    v.u = vb.u;
-    v.v = vb.v;
-    v.argb = vb.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
-
-    v.flags = PVR_CMD_VERTEX_EOL;
-    v.x = vc.position.x;
-    v.y = vc.position.y;
-    v.z = vc.position.z;
-    v.u = vc.u;
-    v.v = vc.v;
-    v.argb = vc.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
+    submit_vertex(PVR_CMD_VERTEX,     &va);
+    submit_vertex(PVR_CMD_VERTEX,     &vb);
+    submit_vertex(PVR_CMD_VERTEX_EOL, &vc);
 
     vertex_count  += 3;
-    vertex_memory += sizeof(hdr) + 3*sizeof(v);
+    vertex_memory += 3*sizeof(pvr_vertex_t);
 }
 
 void gfx_draw_op_tex1555_tri(gfx_vertex_t va, gfx_vertex_t vb, gfx_vertex_t vc, gfx_tid_t tid)
 {
-    pvr_poly_hdr_t hdr;
-    pvr_poly_cxt_t cxt;
-    pvr_vertex_t   v;
-    gfx_texture_t  txr;
+    if(submit_reserve(3) == false) {
+        return;
+    }
 
-    txr = texture[tid];
+    submit_header(GFX_STATE_TEXTURE(tid, GFX_STATE_FMT_ARGB1555), &texture[tid].hdr_argb1555);
 
-    pvr_poly_cxt_txr(&cxt,  PVR_LIST_OP_POLY,
-                            PVR_TXRFMT_ARGB1555 | PVR_TXRFMT_NONTWIDDLED,
-                            txr.width,
-                            txr.height,
-                            txr.pvr_memory,
-                            PVR_FILTER_BILINEAR);
-    pvr_poly_compile(&hdr, &cxt);
-    pvr_prim(&hdr, sizeof(hdr));
-
-    v.flags = PVR_CMD_VERTEX;
-    v.x = va.position.x;
-    v.y = va.position.y;
-    v.z = va.position.z;
-    v.u = va.u;
-    v.v = va.v;
-    v.argb = va.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
-
-    v.flags = PVR_CMD_VERTEX;
-    v.x = vb.position.x;
-    v.y = vb.position.y;
-    v.z = vb.position.z;
-    v.u = vb.u;
-    v.v = vb.v;
-    v.argb = vb.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
-
-    v.flags = PVR_CMD_VERTEX_EOL;
-    v.x = vc.position.x;
-    v.y = vc.position.y;
-    v.z = vc.position.z;
-    v.u = vc.u;
-    v.v = vc.v;
-    v.argb = vc.color.argb;
-    v.oargb = 0;
-    pvr_prim(&v, sizeof(v));
+    submit_vertex(PVR_CMD_VERTEX,     &va);
+    submit_vertex(PVR_CMD_VERTEX,     &vb);
+    submit_vertex(PVR_CMD_VERTEX_EOL, &vc);
 
     vertex_count  += 3;
-    vertex_memory += sizeof(hdr) + 3*sizeof(v);
+    vertex_memory += 3*sizeof(pvr_vertex_t);
+}
+
+// Strips send one vertex per index, only the last of which ends the strip.
+static void submit_strip(const gfx_vertex_t* vertices, const uint16_t* indices, size_t count)
+{
+    for(size_t i = 0; i < count - 1; i++) {
+        submit_vertex(PVR_CMD_VERTEX, &vertices[indices[i]]);
+    }
+    submit_vertex(PVR_CMD_VERTEX_EOL, &vertices[indices[count - 1]]);
+
+    vertex_count  += count;
+    vertex_memory += count*sizeof(pvr_vertex_t);
+}
+
+void gfx_draw_op_strip(const gfx_vertex_t* vertices, const uint16_t* indices, size_t count)
+{
+    if(count < 3 || submit_reserve(count) == false) {
+        return;
+    }
+
+    submit_header(GFX_STATE_COLOR, &color_hdr);
+    submit_strip(vertices, indices, count);
+}
+
+void gfx_draw_op_tex_strip(const gfx_vertex_t* vertices, const uint16_t* indices, size_t count, gfx_tid_t tid)
+{
+    if(count < 3 || submit_reserve(count) == false) {
+        return;
+    }
+
+    submit_header(GFX_STATE_TEXTURE(tid, GFX_STATE_FMT_RGB565), &texture[tid].hdr_rgb565);
+    submit_strip(vertices, indices, count);
 }
 
 void gfx_font_printf(gfx_tid_t tid, float size, float x, float y, const char* fmt, ...)
@@ -332,5 +638,16 @@ void gfx_font_printf(gfx_tid_t tid, float size, float x, float y, const char* fm
 
 gfx_vram_info_t gfx_get_vram_info(void)
 {
-    return (gfx_vram_info_t) { texture_count, texture_memory, vertex_count, vertex_memory };
+#ifdef GFX_SUBMIT_DMA
+    size_t vertex_buffer_size = CONFIG_GFX_VERTEX_BUFFER_SIZE;
+    size_t vertex_dropped     = vertbuf_dropped;
+#else
+    size_t vertex_buffer_size = 0;
+    size_t vertex_dropped     = 0;
+#endif
+
+    size_t texture_memory = mem_get_usage(MEM_TAG_TEXTURE, MEM_POOL_VRAM).current;
+
+    return (gfx_vram_info_t) { texture_count, texture_memory, vertex_count, vertex_memory,
+                               vertex_memory_peak, vertex_buffer_size, vertex_dropped };
 }
\ No newline at end of file
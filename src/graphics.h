@@ -41,6 +41,8 @@ typedef struct gfx_texture_t
     void* pvr_memory;
     size_t width, height, size;
     gfx_tid_t tid;
+    pvr_poly_hdr_t hdr_rgb565;   // Compiled once at load
+    pvr_poly_hdr_t hdr_argb1555;
 } gfx_texture_t;
 
 typedef struct gfx_vram_info_t
@@ -49,6 +51,9 @@ typedef struct gfx_vram_info_t
     size_t texture_memory;
     size_t vertex_count;
     size_t vertex_memory;
+    size_t vertex_memory_peak; // High-water mark of vertex_memory over all frames
+    size_t vertex_buffer_size; // Per-frame DMA vertex buffer capacity, 0 without DMA
+    size_t vertex_dropped;     // Vertices of whole primitives left out for want of buffer space
 } gfx_vram_info_t;
 
 void gfx_initialize(void);
@@ -58,11 +63,73 @@ void gfx_end(void);
 gfx_tid_t gfx_load_texture(const char* asset, size_t width, size_t height);
 void      gfx_free_texture(gfx_tid_t tid);
 
+// Fades polygons into color by their depth, looked up per pixel by the PVR.
+// Distances are in eye space units along w, as is the density.
+void gfx_set_fog_linear(float start, float end, gfx_color_t color);
+void gfx_set_fog_exp(float density, gfx_color_t color);
+void gfx_set_fog_exp2(float density, gfx_color_t color);
+void gfx_disable_fog(void);
+
 void gfx_draw_op_tri(gfx_vertex_t va, gfx_vertex_t vb, gfx_vertex_t vc);
 void gfx_draw_op_tex_tri(gfx_vertex_t va, gfx_vertex_t vb, gfx_vertex_t vc, gfx_tid_t tid);
 
+void gfx_draw_op_strip(const gfx_vertex_t* vertices, const uint16_t* indices, size_t count);
+void gfx_draw_op_tex_strip(const gfx_vertex_t* vertices, const uint16_t* indices, size_t count, gfx_tid_t tid);
+
 void gfx_font_printf(gfx_tid_t tid, float size, float x, float y, const char* fmt, ...);
 
 gfx_vram_info_t gfx_get_vram_info(void);
 
+// ============================================================================
+// Backends - Where frames go. The PVR backend is the default, and its
+// submission is inlined into the draw calls, so it has no state/vertex hooks.
+// ============================================================================
+
+#ifdef CONFIG_GFX_BACKENDS
+
+typedef struct gfx_backend_t
+{
+    const char* name;
+    void (*open)(void);  // On becoming the active backend, may be NULL
+    void (*close)(void); // On being replaced, may be NULL
+    void (*begin)(void);
+    void (*end)(void);
+    void (*state)(const gfx_texture_t* texture, bool argb1555); // Only on change, texture is NULL when untextured
+    void (*vertex)(const gfx_vertex_t* v, bool end_of_strip);
+} gfx_backend_t;
+
+extern const gfx_backend_t gfx_backend_pvr;
+extern const gfx_backend_t gfx_backend_null;
+extern const gfx_backend_t gfx_backend_soft;
+
+// Not in between gfx_begin and gfx_end
+void                 gfx_set_backend(const gfx_backend_t* backend);
+const gfx_backend_t* gfx_get_backend(void);
+
+// With CONFIG_GFX_DIRECT_RENDER, sends the PVR backend's vertices through the
+// staging vertex and pvr_prim instead, which should reach the TA unchanged.
+// Does nothing in the other submission modes. Not in between gfx_begin and gfx_end.
+void                 gfx_set_direct_render(bool enabled);
+
+// Null backend: draws nothing, counts what the PVR would have been sent
+typedef struct gfx_null_stats_t
+{
+    size_t frames;
+    size_t headers;         // State changes
+    size_t texture_changes; // Headers for a different texture than the last textured one
+    size_t vertices;
+    size_t strips;
+    size_t triangles;
+} gfx_null_stats_t;
+
+gfx_null_stats_t gfx_null_get_stats(void);
+void             gfx_null_reset_stats(void);
+
+// Software backend: rasterizes into RAM and writes every frame as a PPM file
+// named by the printf pattern, which takes the frame number. NULL only
+// rasterizes. Gouraud shaded, point sampled modulated textures, no fog.
+void gfx_soft_set_output(const char* pattern);
+
+#endif // CONFIG_GFX_BACKENDS
+
 #endif // GRAPHICS_H
\ No newline at end of file
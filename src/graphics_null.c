@@ -0,0 +1,74 @@
+// ============================================================================
+// File:        graphics_null.c
+// Description: Graphics backend that only counts what it is sent (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#define DEBUG_CHANNEL DEBUG_CHANNEL_GFX
+
+#include "config.h"
+
+#include "graphics.h"
+
+#ifdef CONFIG_GFX_BACKENDS
+
+static gfx_null_stats_t     stats;
+static const gfx_texture_t* last_texture;
+static size_t               strip_length; // Vertices so far in the current strip
+
+gfx_null_stats_t gfx_null_get_stats(void)
+{
+    return stats;
+}
+
+void gfx_null_reset_stats(void)
+{
+    gfx_null_stats_t s = {0};
+    stats = s;
+}
+
+static void null_begin(void)
+{
+    last_texture = NULL;
+    strip_length = 0;
+}
+
+static void null_end(void)
+{
+    stats.frames++;
+}
+
+static void null_state(const gfx_texture_t* texture, bool argb1555)
+{
+    (void)argb1555;
+
+    stats.headers++;
+
+    if(texture != NULL && texture != last_texture) {
+        stats.texture_changes++;
+        last_texture = texture;
+    }
+}
+
+static void null_vertex(const gfx_vertex_t* v, bool end_of_strip)
+{
+    (void)v;
+
+    stats.vertices++;
+
+    if(++strip_length >= 3) {
+        stats.triangles++;
+    }
+
+    if(end_of_strip) {
+        stats.strips++;
+        strip_length = 0;
+    }
+}
+
+const gfx_backend_t gfx_backend_null = {
+    "Null", NULL, NULL, null_begin, null_end, null_state, null_vertex
+};
+
+#endif // CONFIG_GFX_BACKENDS
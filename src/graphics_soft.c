@@ -0,0 +1,250 @@
+// ============================================================================
+// File:        graphics_soft.c
+// Description: Graphics backend that rasterizes on the CPU (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+// Reference renderer for looking at frames off-target and comparing them
+// between changes, not a PVR emulator. Triangles counter-clockwise on screen
+// are culled as by the headers' PVR_CULLING_CCW, with every other triangle of
+// a strip reversed first, since model.c leaves some back faces to the PVR.
+// Depth is tested with greater being nearer, as the PVR's default compare.
+// Colors and texture coordinates are interpolated linearly in screen space.
+// Textures are point sampled with wrapping and modulated by the vertex color,
+// alpha is ignored as in the opaque list.
+
+#define DEBUG_CHANNEL DEBUG_CHANNEL_GFX
+
+#include "config.h"
+
+#include "graphics.h"
+#include "debug.h"
+#include "mem.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#ifdef CONFIG_GFX_BACKENDS
+
+#define SOFT_PIXELS (CONFIG_SCREEN_W * CONFIG_SCREEN_H)
+
+static uint8_t*             color; // RGB888, as written to the PPM
+static float*               depth;
+static const char*          output = CONFIG_GFX_SOFT_OUTPUT;
+static uint32_t             frame;
+
+static const gfx_texture_t* texture;
+static bool                 texture_argb1555;
+static gfx_vertex_t         strip[2]; // Last two vertices of the current strip
+static size_t               strip_length;
+
+void gfx_soft_set_output(const char* pattern)
+{
+    output = pattern;
+}
+
+static void soft_open(void)
+{
+    color = mem_malloc(MEM_TAG_SCRATCH, SOFT_PIXELS * 3);
+    depth = mem_malloc(MEM_TAG_SCRATCH, SOFT_PIXELS * sizeof(float));
+
+    if(color == NULL || depth == NULL) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate software framebuffer.\n");
+    }
+
+    frame = 0;
+}
+
+static void soft_close(void)
+{
+    mem_free(MEM_TAG_SCRATCH, color);
+    mem_free(MEM_TAG_SCRATCH, depth);
+    color = NULL;
+    depth = NULL;
+}
+
+static void soft_begin(void)
+{
+    texture      = NULL;
+    strip_length = 0;
+
+    if(color == NULL || depth == NULL) {
+        return;
+    }
+
+    for(size_t i = 0; i < SOFT_PIXELS * 3; i++) {
+        color[i] = 0;
+    }
+
+    for(size_t i = 0; i < SOFT_PIXELS; i++) {
+        depth[i] = 0.0f;
+    }
+}
+
+static void write_ppm(void)
+{
+    char  path[256];
+    FILE* f;
+
+    snprintf(path, sizeof(path), output, frame);
+
+    if((f = fopen(path, "wb")) == NULL) {
+        debug_printf(DEBUG_ERROR, "Couldn't open frame for writing: %s\n", path);
+        return;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", CONFIG_SCREEN_W, CONFIG_SCREEN_H);
+
+    if(fwrite(color, 3, SOFT_PIXELS, f) != SOFT_PIXELS) {
+        debug_printf(DEBUG_ERROR, "Failed to write frame to: %s\n", path);
+    }
+
+    fclose(f);
+}
+
+static void soft_end(void)
+{
+    if(color != NULL && output != NULL) {
+        write_ppm();
+    }
+
+    frame++;
+}
+
+static void soft_state(const gfx_texture_t* t, bool argb1555)
+{
+    texture          = t;
+    texture_argb1555 = argb1555;
+}
+
+// Texel as 0..255 RGB
+static void sample(float u, float v, float* rgb)
+{
+    int x = (int)floorf(u * texture->width)  & (int)(texture->width  - 1);
+    int y = (int)floorf(v * texture->height) & (int)(texture->height - 1);
+
+    uint16_t p = ((const uint16_t*)texture->pvr_memory)[y * texture->width + x];
+
+    if(texture_argb1555) {
+        rgb[0] = ((p >> 10) & 0x1F) * (255.0f / 31.0f);
+        rgb[1] = ((p >> 5)  & 0x1F) * (255.0f / 31.0f);
+        rgb[2] = ( p        & 0x1F) * (255.0f / 31.0f);
+    } else {
+        rgb[0] = ((p >> 11) & 0x1F) * (255.0f / 31.0f);
+        rgb[1] = ((p >> 5)  & 0x3F) * (255.0f / 63.0f);
+        rgb[2] = ( p        & 0x1F) * (255.0f / 31.0f);
+    }
+}
+
+INLINE float edge(const vec3_t* a, const vec3_t* b, float x, float y)
+{
+    return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+INLINE float clampf(float x, float lo, float hi)
+{
+    return (x < lo) ? lo : (x > hi) ? hi : x;
+}
+
+// Odd triangles of a strip are wound the other way round, as the PVR reads them
+static void draw_triangle(const gfx_vertex_t* va, const gfx_vertex_t* vb, const gfx_vertex_t* vc, bool odd)
+{
+    const vec3_t* a = &va->position;
+    const vec3_t* b = &vb->position;
+    const vec3_t* c = &vc->position;
+
+    float area = edge(a, b, c->x, c->y);
+
+    if(!(area != 0.0f) || !isfinite(area)) {
+        return; // Degenerate, or NaN from a bad transform
+    }
+
+    if((area < 0.0f) != odd) {
+        return; // Counter-clockwise on screen (y down)
+    }
+
+    // Pixel centers inside the bounding box, clamped to the screen
+    float min_x = clampf(fminf(a->x, fminf(b->x, c->x)), 0.0f, CONFIG_SCREEN_W);
+    float max_x = clampf(fmaxf(a->x, fmaxf(b->x, c->x)), 0.0f, CONFIG_SCREEN_W);
+    float min_y = clampf(fminf(a->y, fminf(b->y, c->y)), 0.0f, CONFIG_SCREEN_H);
+    float max_y = clampf(fmaxf(a->y, fmaxf(b->y, c->y)), 0.0f, CONFIG_SCREEN_H);
+
+    int x0 = (int)ceilf(min_x - 0.5f), x1 = (int)floorf(max_x - 0.5f);
+    int y0 = (int)ceilf(min_y - 0.5f), y1 = (int)floorf(max_y - 0.5f);
+
+    if(x1 >= CONFIG_SCREEN_W) x1 = CONFIG_SCREEN_W - 1;
+    if(y1 >= CONFIG_SCREEN_H) y1 = CONFIG_SCREEN_H - 1;
+
+    // Barycentric weights step linearly along a row
+    float inv = 1.0f / area;
+    float dx0 = -(c->y - b->y) * inv;
+    float dx1 = -(a->y - c->y) * inv;
+    float dx2 = -(b->y - a->y) * inv;
+
+    const gfx_color_t* ca = &va->color;
+    const gfx_color_t* cb = &vb->color;
+    const gfx_color_t* cc = &vc->color;
+
+    for(int y = y0; y <= y1; y++) {
+        float py = y + 0.5f;
+        float px = x0 + 0.5f;
+        float w0 = edge(b, c, px, py) * inv;
+        float w1 = edge(c, a, px, py) * inv;
+        float w2 = edge(a, b, px, py) * inv;
+
+        for(int x = x0; x <= x1; x++, w0 += dx0, w1 += dx1, w2 += dx2) {
+            if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                continue;
+            }
+
+            size_t i = (size_t)y * CONFIG_SCREEN_W + x;
+            float  z = w0 * a->z + w1 * b->z + w2 * c->z;
+
+            if(z <= depth[i]) {
+                continue;
+            }
+
+            depth[i] = z;
+
+            float rgb[3] = {
+                w0 * ca->component.r + w1 * cb->component.r + w2 * cc->component.r,
+                w0 * ca->component.g + w1 * cb->component.g + w2 * cc->component.g,
+                w0 * ca->component.b + w1 * cb->component.b + w2 * cc->component.b
+            };
+
+            if(texture != NULL) {
+                float texel[3];
+                sample(w0 * va->u + w1 * vb->u + w2 * vc->u, w0 * va->v + w1 * vb->v + w2 * vc->v, texel);
+
+                for(int k = 0; k < 3; k++) {
+                    rgb[k] = rgb[k] * texel[k] * (1.0f / 255.0f);
+                }
+            }
+
+            for(int k = 0; k < 3; k++) {
+                color[i * 3 + k] = (uint8_t)clampf(rgb[k] + 0.5f, 0.0f, 255.0f);
+            }
+        }
+    }
+}
+
+static void soft_vertex(const gfx_vertex_t* v, bool end_of_strip)
+{
+    if(strip_length >= 2 && color != NULL) {
+        draw_triangle(&strip[0], &strip[1], v, (strip_length & 1) != 0);
+    }
+
+    strip[0] = strip[1];
+    strip[1] = *v;
+    strip_length++;
+
+    if(end_of_strip) {
+        strip_length = 0;
+    }
+}
+
+const gfx_backend_t gfx_backend_soft = {
+    "Software", soft_open, soft_close, soft_begin, soft_end, soft_state, soft_vertex
+};
+
+#endif // CONFIG_GFX_BACKENDS
@@ -5,65 +5,539 @@
 // Date:        2023/12/16
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_LIGHT
+
 #include "config.h"
 #include "debug.h"
 #include "light.h"
 #include "mv.h"
 #include "graphics.h"
 
-static light_t ambient;
-static light_t point;
+#include <string.h>
+
+#define LIGHT_BATCH_SIZE (128) // Vertices accumulated at a time, 1.5 KiB
+
+// Lights as they were set, in eye space. Colors are premultiplied by
+// intensity and kept as floats in 0..1.
+static bool         light_occupied[CONFIG_MAX_LIGHTS];
+static light_type_t light_type[CONFIG_MAX_LIGHTS];
+static float        light_r[CONFIG_MAX_LIGHTS];
+static float        light_g[CONFIG_MAX_LIGHTS];
+static float        light_b[CONFIG_MAX_LIGHTS];
+static vec3_t       light_position[CONFIG_MAX_LIGHTS];
+static vec3_t       light_direction[CONFIG_MAX_LIGHTS];
+static float        light_range[CONFIG_MAX_LIGHTS];
+static float        light_cos_inner[CONFIG_MAX_LIGHTS];
+static float        light_cos_outer[CONFIG_MAX_LIGHTS];
+static size_t       light_count;
+static uint32_t     light_version; // Bumped whenever any of the above changes
+
+static light_lid_t  default_ambient = LIGHT_ERROR;
+static light_lid_t  default_point   = LIGHT_ERROR;
+
+// Lights that reach the model being drawn, in its object space, and in
+// LIGHT_MODE_SH their projection (see project_sh). Compared after every
+// light_prepare, to tell whether the model is lit the same way as the last.
+typedef struct light_active_t
+{
+    size_t       count;
+    light_mode_t mode;
+    float        ambient_r, ambient_g, ambient_b;
+    light_type_t type[CONFIG_MAX_LIGHTS];
+    float        r[CONFIG_MAX_LIGHTS];
+    float        g[CONFIG_MAX_LIGHTS];
+    float        b[CONFIG_MAX_LIGHTS];
+    float        px[CONFIG_MAX_LIGHTS];           // Position
+    float        py[CONFIG_MAX_LIGHTS];
+    float        pz[CONFIG_MAX_LIGHTS];
+    float        dx[CONFIG_MAX_LIGHTS];           // Unit direction towards the light
+    float        dy[CONFIG_MAX_LIGHTS];
+    float        dz[CONFIG_MAX_LIGHTS];
+    float        inv_range_sq[CONFIG_MAX_LIGHTS]; // 0 for unlimited
+    float        cos_outer[CONFIG_MAX_LIGHTS];
+    float        spot_scale[CONFIG_MAX_LIGHTS];   // 1 / (cos inner - cos outer)
+    float        sh_r[9], sh_g[9], sh_b[9];
+} light_active_t;
+
+static light_active_t active;
+static uint32_t       active_version; // Bumped whenever light_prepare changes active
+
+static light_mode_t light_mode = LIGHT_MODE_VERTEX;
+
+// Sky and ground colors for LIGHT_MODE_SH, premultiplied like the lights
+static bool         environment_enabled;
+static float        environment_sky[3];
+static float        environment_ground[3];
+static vec3_t       environment_up;
+
+
+// Per vertex sums of a batch
+static float accum_r[LIGHT_BATCH_SIZE];
+static float accum_g[LIGHT_BATCH_SIZE];
+static float accum_b[LIGHT_BATCH_SIZE];
+
+light_lid_t light_add(light_t l)
+{
+    if(light_count >= CONFIG_MAX_LIGHTS) {
+        debug_printf(DEBUG_ERROR, "Cannot allocate more than %d lights.\n", CONFIG_MAX_LIGHTS);
+        return LIGHT_ERROR;
+    }
+
+    light_lid_t first_available = 0;
+    while(light_occupied[first_available] == true) {
+        first_available++;
+    }
+
+    light_occupied[first_available] = true;
+    light_count++;
+    light_version++;
+
+    light_update(first_available, l);
+
+    return first_available;
+}
+
+void light_update(light_lid_t lid, light_t l)
+{
+    if(lid >= CONFIG_MAX_LIGHTS || light_occupied[lid] == false) {
+        debug_printf(DEBUG_ERROR, "Received invalid light ID (%d) for updating.\n", lid);
+        return;
+    }
+
+    float r         = l.intensity * l.color.component.r * (1.0f / 255.0f);
+    float g         = l.intensity * l.color.component.g * (1.0f / 255.0f);
+    float b         = l.intensity * l.color.component.b * (1.0f / 255.0f);
+    float cos_inner = fcos(l.inner);
+    float cos_outer = fcos(l.outer);
+
+    // Setting the same light every frame must not invalidate cached lighting
+    if(light_type[lid] == l.type && light_r[lid] == r && light_g[lid] == g && light_b[lid] == b &&
+       memcmp(&light_position[lid],  &l.position,  sizeof(vec3_t)) == 0 &&
+       memcmp(&light_direction[lid], &l.direction, sizeof(vec3_t)) == 0 &&
+       light_range[lid] == l.range && light_cos_inner[lid] == cos_inner && light_cos_outer[lid] == cos_outer) {
+        return;
+    }
+
+    light_type[lid]      = l.type;
+    light_r[lid]         = r;
+    light_g[lid]         = g;
+    light_b[lid]         = b;
+    light_position[lid]  = l.position;
+    light_direction[lid] = l.direction;
+    light_range[lid]     = l.range;
+    light_cos_inner[lid] = cos_inner;
+    light_cos_outer[lid] = cos_outer;
+    light_version++;
+}
+
+void light_remove(light_lid_t lid)
+{
+    if(lid >= CONFIG_MAX_LIGHTS || light_occupied[lid] == false) {
+        debug_printf(DEBUG_ERROR, "Received invalid light ID (%d) for removing.\n", lid);
+        return;
+    }
+
+    light_occupied[lid] = false;
+    light_count--;
+    light_version++;
+
+    if(lid == default_ambient) default_ambient = LIGHT_ERROR;
+    if(lid == default_point)   default_point   = LIGHT_ERROR;
+}
+
+uint32_t light_get_version(void)
+{
+    return light_version;
+}
 
-static gfx_color_t color;
+static void set_default(light_lid_t* lid, light_t l)
+{
+    if(*lid == LIGHT_ERROR) {
+        *lid = light_add(l);
+    } else {
+        light_update(*lid, l);
+    }
+}
 
 void light_set_ambient(light_t l)
 {
-    ambient = l;
+    l.type = LIGHT_AMBIENT;
+    set_default(&default_ambient, l);
 }
 
 void light_set_point(light_t l)
 {
-    point = l;
+    l.type = LIGHT_POINT;
+    set_default(&default_point, l);
 }
 
-gfx_color_t light_calculate_color(vec3_t vertex_position, vec3_t normal)
+// ============================================================================
+// Spherical Harmonics - Constant cost per vertex, whatever the light count
+// ============================================================================
+// Lights are projected into the first 9 real SH basis functions, convolved
+// with the cosine lobe (Ramamoorthi & Hanrahan), and the normalization
+// constants folded in. What is left per vertex is a fixed polynomial of the
+// normal: c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1) + c7 xz + c8 (x^2 - y^2).
+// Point and spot lights are taken as seen from the center of the model.
+
+#define SH_BAND0 (0.25f)     // pi   * 0.282095^2
+#define SH_BAND1 (0.5f)      // 2pi/3 * 0.488603^2
+#define SH_XY    (0.9375f)   // pi/4 * 1.092548^2
+#define SH_ZZ    (0.078125f) // pi/4 * 0.315392^2
+#define SH_XXYY  (0.234375f) // pi/4 * 0.546274^2
+
+static void project_sh(vec3_t center)
 {
-    float       ambient_intensity = ambient.intensity;
-    gfx_color_t ambient_color     = ambient.color;
+    float* c[3] = {active.sh_r, active.sh_g, active.sh_b};
+
+    for(size_t i = 0; i < 9; i++) {
+        active.sh_r[i] = active.sh_g[i] = active.sh_b[i] = 0.0f;
+    }
 
-    float ambient_r = ambient_intensity * ((float)ambient_color.component.r / 255.0f);
-    float ambient_g = ambient_intensity * ((float)ambient_color.component.g / 255.0f);
-    float ambient_b = ambient_intensity * ((float)ambient_color.component.b / 255.0f);
+    active.sh_r[0] = active.ambient_r;
+    active.sh_g[0] = active.ambient_g;
+    active.sh_b[0] = active.ambient_b;
 
-    float       point_intensity = point.intensity;
-    gfx_color_t point_color     = point.color;
+    // Sky above and ground below, exact in the first two bands
+    if(environment_enabled == true) {
+        vec3_t up = mv_eye_to_object_direction(environment_up);
+        float  l  = mv_vec_scalar_product(up, up);
+        up = (l > 0.0f) ? mv_vec_scale(up, frsqrt(l)) : up;
 
-    vec3_t vertex_to_light = mv_vec_sub(point.position, vertex_position);
-    float directness = mv_vec_scalar_product(mv_vec_normalize(vertex_to_light), mv_vec_normalize(normal));
-    
-    if(directness < 0.0f) {
-        directness = 0.0f;
+        const float* sky    = environment_sky;
+        const float* ground = environment_ground;
+
+        for(size_t k = 0; k < 3; k++) {
+            float half_difference = 0.5f * (sky[k] - ground[k]);
+            c[k][0] += 0.5f * (sky[k] + ground[k]);
+            c[k][1] += half_difference * up.y;
+            c[k][2] += half_difference * up.z;
+            c[k][3] += half_difference * up.x;
+        }
     }
 
-    //directness = 0.0f;
+    for(size_t a = 0; a < active.count; a++) {
+        vec3_t d;
+        float  weight = 1.0f;
 
-    float point_r = directness * point_intensity * ((float)point_color.component.r / 255.0f);
-    float point_g = directness * point_intensity * ((float)point_color.component.g / 255.0f);
-    float point_b = directness * point_intensity * ((float)point_color.component.b / 255.0f);
+        if(active.type[a] == LIGHT_DIRECTIONAL) {
+            d = (vec3_t){active.dx[a], active.dy[a], active.dz[a]};
+        } else {
+            d = (vec3_t){active.px[a] - center.x, active.py[a] - center.y, active.pz[a] - center.z};
 
-    float total_r = ambient_r + point_r;
-    float total_g = ambient_g + point_g;
-    float total_b = ambient_b + point_b;
+            float d2 = mv_vec_scalar_product(d, d);
 
-    if(total_r > 1.0f) total_r = 1.0f;
-    if(total_g > 1.0f) total_g = 1.0f;
-    if(total_b > 1.0f) total_b = 1.0f;
+            if(d2 == 0.0f) {
+                continue;
+            }
 
-    color.component.a = 255;
-    color.component.r = (uint8_t)(total_r * 255);
-    color.component.g = (uint8_t)(total_g * 255);
-    color.component.b = (uint8_t)(total_b * 255);
+            d       = mv_vec_scale(d, frsqrt(d2));
+            weight -= d2 * active.inv_range_sq[a];
 
-    return color;
+            if(active.type[a] == LIGHT_SPOT) {
+                float cos_angle = d.x * active.dx[a] + d.y * active.dy[a] + d.z * active.dz[a];
+                float cone      = (cos_angle - active.cos_outer[a]) * active.spot_scale[a];
+                weight *= (cone < 0.0f) ? 0.0f : (cone > 1.0f) ? 1.0f : cone;
+            }
+
+            if(weight <= 0.0f) {
+                continue;
+            }
+        }
+
+        float basis[9] = {
+            SH_BAND0,
+            SH_BAND1 * d.y,
+            SH_BAND1 * d.z,
+            SH_BAND1 * d.x,
+            SH_XY    * d.x * d.y,
+            SH_XY    * d.y * d.z,
+            SH_ZZ    * (3.0f * d.z * d.z - 1.0f),
+            SH_XY    * d.x * d.z,
+            SH_XXYY  * (d.x * d.x - d.y * d.y)
+        };
+
+        float color[3] = {active.r[a] * weight, active.g[a] * weight, active.b[a] * weight};
+
+        for(size_t k = 0; k < 3; k++) {
+            for(size_t i = 0; i < 9; i++) {
+                c[k][i] += color[k] * basis[i];
+            }
+        }
+    }
 }
 
+static void accumulate_sh(const vec3_t* normals, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        float x = normals[i].x, y = normals[i].y, z = normals[i].z;
+        float p[9] = {1.0f, y, z, x, x * y, y * z, 3.0f * z * z - 1.0f, x * z, x * x - y * y};
+
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+
+        for(size_t k = 0; k < 9; k++) {
+            r += active.sh_r[k] * p[k];
+            g += active.sh_g[k] * p[k];
+            b += active.sh_b[k] * p[k];
+        }
+
+        accum_r[i] = r;
+        accum_g[i] = g;
+        accum_b[i] = b;
+    }
+}
+
+void light_set_mode(light_mode_t mode)
+{
+    if(mode != light_mode) {
+        light_mode = mode;
+        light_version++;
+    }
+}
+
+void light_set_environment(gfx_color_t sky, gfx_color_t ground, vec3_t up, float intensity)
+{
+    float s[3] = {intensity * sky.component.r    * (1.0f / 255.0f),
+                  intensity * sky.component.g    * (1.0f / 255.0f),
+                  intensity * sky.component.b    * (1.0f / 255.0f)};
+    float g[3] = {intensity * ground.component.r * (1.0f / 255.0f),
+                  intensity * ground.component.g * (1.0f / 255.0f),
+                  intensity * ground.component.b * (1.0f / 255.0f)};
+
+    bool enabled = intensity > 0.0f;
+
+    if(enabled == environment_enabled &&
+       memcmp(s, environment_sky, sizeof(s)) == 0 && memcmp(g, environment_ground, sizeof(g)) == 0 &&
+       memcmp(&up, &environment_up, sizeof(vec3_t)) == 0) {
+        return;
+    }
+
+    memcpy(environment_sky,    s, sizeof(s));
+    memcpy(environment_ground, g, sizeof(g));
+    environment_up      = up;
+    environment_enabled = enabled;
+    light_version++;
+}
+
+void light_prepare(vec3_t center, float radius)
+{
+    light_active_t previous = active;
+
+    active.mode      = light_mode;
+    active.ambient_r = active.ambient_g = active.ambient_b = 0.0f;
+    active.count     = 0;
+
+    // Object units per eye unit, along the longest axis so ranges stay conservative
+    float scale_sq = 0.0f;
+    for(size_t i = 0; i < 3; i++) {
+        vec3_t axis = mv_eye_to_object_direction((vec3_t){i == 0, i == 1, i == 2});
+        float  l    = mv_vec_scalar_product(axis, axis);
+        if(l > scale_sq) scale_sq = l;
+    }
+    float scale = fsqrt(scale_sq);
+
+    for(size_t i = 0; i < CONFIG_MAX_LIGHTS; i++) {
+        // Black lights (like a default light turned down) add nothing
+        if(light_occupied[i] == false || (light_r[i] == 0.0f && light_g[i] == 0.0f && light_b[i] == 0.0f)) {
+            continue;
+        }
+
+        if(light_type[i] == LIGHT_AMBIENT) {
+            active.ambient_r += light_r[i];
+            active.ambient_g += light_g[i];
+            active.ambient_b += light_b[i];
+            continue;
+        }
+
+        size_t a = active.count;
+
+        active.inv_range_sq[a] = 0.0f;
+
+        if(light_type[i] != LIGHT_DIRECTIONAL) {
+            vec3_t p = mv_eye_to_object(light_position[i]);
+
+            if(light_range[i] > 0.0f) {
+                float  range = light_range[i] * scale;
+                vec3_t d     = mv_vec_sub(p, center);
+
+                if(mv_vec_scalar_product(d, d) > (range + radius) * (range + radius)) {
+                    continue;
+                }
+
+                active.inv_range_sq[a] = 1.0f / (range * range);
+            }
+
+            active.px[a] = p.x;
+            active.py[a] = p.y;
+            active.pz[a] = p.z;
+        }
+
+        if(light_type[i] != LIGHT_POINT) {
+            vec3_t d = mv_eye_to_object_direction(light_direction[i]);
+            float  l = mv_vec_scalar_product(d, d);
+
+            if(l == 0.0f) {
+                continue;
+            }
+
+            d = mv_vec_scale(d, -frsqrt(l));
+
+            active.dx[a] = d.x;
+            active.dy[a] = d.y;
+            active.dz[a] = d.z;
+
+            float spread = light_cos_inner[i] - light_cos_outer[i];
+
+            active.cos_outer[a]  = light_cos_outer[i];
+            active.spot_scale[a] = (spread > 1e-6f) ? 1.0f / spread : 1e6f;
+        }
+
+        active.type[a] = light_type[i];
+        active.r[a]    = light_r[i];
+        active.g[a]    = light_g[i];
+        active.b[a]    = light_b[i];
+        active.count++;
+    }
+
+    if(light_mode == LIGHT_MODE_SH) {
+        project_sh(center);
+    }
+
+    // Entries past count are left as they were, so they compare equal
+    if(memcmp(&previous, &active, sizeof(light_active_t)) != 0) {
+        active_version++;
+    }
+}
+
+uint32_t light_get_prepared_version(void)
+{
+    return active_version;
+}
+
+// Lambert term of a point or spot light, faded out towards its range. Also
+// returns the unnormalized vector to the light and its inverse length.
+INLINE float point_factor(size_t a, vec3_t p, vec3_t n, vec3_t* to_light, float* inv_distance)
+{
+    vec3_t d  = {active.px[a] - p.x, active.py[a] - p.y, active.pz[a] - p.z};
+    float  dn = mv_vec_scalar_product(d, n);
+
+    if(dn <= 0.0f) {
+        return 0.0f;
+    }
+
+    float d2 = mv_vec_scalar_product(d, d);
+    float rs = frsqrt(d2);
+
+    *to_light     = d;
+    *inv_distance = rs;
+
+    return dn * rs * (1.0f - d2 * active.inv_range_sq[a]);
+}
+
+static void accumulate_batch(const vec3_t* positions, const vec3_t* normals, size_t n)
+{
+    for(size_t i = 0; i < n; i++) {
+        accum_r[i] = active.ambient_r;
+        accum_g[i] = active.ambient_g;
+        accum_b[i] = active.ambient_b;
+    }
+
+    // One light at a time over every vertex, so its parameters stay in
+    // registers and the loop body is the same for every iteration
+    for(size_t a = 0; a < active.count; a++) {
+        float r = active.r[a], g = active.g[a], b = active.b[a];
+
+        switch(active.type[a]) {
+        case LIGHT_DIRECTIONAL:
+            for(size_t i = 0; i < n; i++) {
+                float f = normals[i].x * active.dx[a] + normals[i].y * active.dy[a] + normals[i].z * active.dz[a];
+                if(f > 0.0f) {
+                    accum_r[i] += f * r;
+                    accum_g[i] += f * g;
+                    accum_b[i] += f * b;
+                }
+            }
+            break;
+
+        case LIGHT_POINT:
+            for(size_t i = 0; i < n; i++) {
+                vec3_t d;
+                float  rs;
+                float  f = point_factor(a, positions[i], normals[i], &d, &rs);
+                if(f > 0.0f) {
+                    accum_r[i] += f * r;
+                    accum_g[i] += f * g;
+                    accum_b[i] += f * b;
+                }
+            }
+            break;
+
+        case LIGHT_SPOT:
+            for(size_t i = 0; i < n; i++) {
+                vec3_t d;
+                float  rs;
+                float  f = point_factor(a, positions[i], normals[i], &d, &rs);
+                if(f > 0.0f) {
+                    float c    = (d.x * active.dx[a] + d.y * active.dy[a] + d.z * active.dz[a]) * rs;
+                    float cone = (c - active.cos_outer[a]) * active.spot_scale[a];
+                    if(cone > 0.0f) {
+                        if(cone > 1.0f) cone = 1.0f;
+                        accum_r[i] += f * cone * r;
+                        accum_g[i] += f * cone * g;
+                        accum_b[i] += f * cone * b;
+                    }
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void light_calculate_batch(const vec3_t* positions, const vec3_t* normals, gfx_color_t* out_colors, size_t n)
+{
+    while(n > 0) {
+        size_t count = (n < LIGHT_BATCH_SIZE) ? n : LIGHT_BATCH_SIZE;
+
+        if(light_mode == LIGHT_MODE_SH) {
+            accumulate_sh(normals, count);
+        } else {
+            accumulate_batch(positions, normals, count);
+        }
+
+        for(size_t i = 0; i < count; i++) {
+            float total_r = accum_r[i];
+            float total_g = accum_g[i];
+            float total_b = accum_b[i];
+
+            // SH can ring below zero opposite a strong light
+            if(total_r < 0.0f) total_r = 0.0f;
+            if(total_g < 0.0f) total_g = 0.0f;
+            if(total_b < 0.0f) total_b = 0.0f;
+            if(total_r > 1.0f) total_r = 1.0f;
+            if(total_g > 1.0f) total_g = 1.0f;
+            if(total_b > 1.0f) total_b = 1.0f;
+
+            out_colors[i].component.a = 255;
+            out_colors[i].component.r = (uint8_t)(total_r * 255);
+            out_colors[i].component.g = (uint8_t)(total_g * 255);
+            out_colors[i].component.b = (uint8_t)(total_b * 255);
+        }
+
+        positions  += count;
+        normals    += count;
+        out_colors += count;
+        n          -= count;
+    }
+}
+
+gfx_color_t light_calculate_color(vec3_t vertex_position, vec3_t normal)
+{
+    gfx_color_t color;
+
+    light_calculate_batch(&vertex_position, &normal, &color, 1);
+
+    return color;
+}
@@ -11,22 +11,68 @@
 #include "mv.h"
 #include "graphics.h"
 
+typedef uint8_t light_lid_t;
+
+#define LIGHT_ERROR (255)
+
 typedef enum light_type_t
 {
-    LIGHT_AMBIENT, LIGHT_POINT
+    LIGHT_AMBIENT, LIGHT_POINT, LIGHT_DIRECTIONAL, LIGHT_SPOT
 } light_type_t;
 
+typedef enum light_mode_t
+{
+    LIGHT_MODE_VERTEX, // Every light evaluated at every vertex
+    LIGHT_MODE_SH      // All lights folded into spherical harmonics once per model
+} light_mode_t;
+
+// Positions and directions are in eye space, i.e. after the modelview.
+// Directions point the way the light travels and need not be normalized.
 typedef struct light_t
 {
     light_type_t type;
-    vec3_t       position;
+    vec3_t       position;  // Point and spot
     gfx_color_t  color;
     float        intensity;
+    vec3_t       direction; // Directional and spot
+    float        range;     // Point and spot, fades to zero at range. 0 for unlimited.
+    float        inner;     // Spot, half angles of the full and faded cone in radians
+    float        outer;
 } light_t;
 
+light_lid_t light_add(light_t l);
+void        light_update(light_lid_t lid, light_t l);
+void        light_remove(light_lid_t lid);
+
+// Changes only when a light really does, so cached lighting can be kept until then
+uint32_t    light_get_version(void);
+
+// Keep a single ambient and point light of their own, as before
 void light_set_ambient(light_t l);
 void light_set_point(light_t l);
 
+// In LIGHT_MODE_SH the cost per vertex no longer depends on the number of
+// lights, at the price of point and spot lights being seen from the center of
+// each model and of soft, low frequency shading.
+void light_set_mode(light_mode_t mode);
+
+// Sky colored light from up (in eye space) fading into ground colored light
+// from below, only in LIGHT_MODE_SH. An intensity of 0 turns it off.
+void light_set_environment(gfx_color_t sky, gfx_color_t ground, vec3_t up, float intensity);
+
+// Moves the lights into the space of the vertices of the current transform,
+// dropping those whose range doesn't reach the given bounding sphere (in
+// that same space). Call once per draw, after mv_calculate_transform.
+void light_prepare(vec3_t center, float radius);
+
+// Changes only when light_prepare gives different lights than the call before
+// it, so instances of a model lit the same way relative to each of them (say
+// by directional lights, under translation) can share their lighting
+uint32_t    light_get_prepared_version(void);
+
+// Positions and unit normals in the space given to light_prepare. Works one
+// light at a time over all n vertices.
+void        light_calculate_batch(const vec3_t* positions, const vec3_t* normals, gfx_color_t* out_colors, size_t n);
 gfx_color_t light_calculate_color(vec3_t vertex_position, vec3_t normal);
 
 
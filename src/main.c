@@ -5,6 +5,8 @@
 // Date:        2023/12/04
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_CORE
+
 #include <kos.h>
 
 #include "config.h"
@@ -14,6 +16,8 @@
 #include "model.h"
 #include "mv.h"
 #include "light.h"
+#include "prof.h"
+#include "mem.h"
 
 int main(void)
 {
@@ -21,12 +25,17 @@ int main(void)
 
     gfx_initialize();
 
+    mem_initialize();
+
     model_initialize();
 
     controller_initialize();
 
+    prof_initialize();
+
     mv_set_matrix_model(MV_PROJECTION);
     mv_identity();
+    mv_perspective_screen(CONFIG_SCREEN_W / 2.0f, CONFIG_SCREEN_H / 2.0f, 500.0f); // Models at z = 500 keep their size
 
     mv_set_matrix_model(MV_MODELVIEW);
     mv_identity();
@@ -34,19 +43,39 @@ int main(void)
     gfx_tid_t font_texture = gfx_load_texture("/rd/asset/texture/font_256x256.1555", 256, 256);
     gfx_tid_t earth_texture = gfx_load_texture("/rd/asset/texture/earth_512x512.565", 512, 512);
 
-    model_mid_t uvsphere_model  = model_load_obj("/rd/asset/model/uvsphere_medium.obj", GFX_UNUSED, false);
-    model_mid_t icosphere_model = model_load_obj("/rd/asset/model/icosphere_medium.obj", GFX_UNUSED, false);
+    model_mid_t uvsphere_model  = model_load_bin("/rd/asset/model/uvsphere_medium.mdl", GFX_UNUSED, false);
+    model_mid_t icosphere_levels[3] = {
+        model_load_bin("/rd/asset/model/icosphere_medium.mdl",      GFX_UNUSED, false),
+        model_load_bin("/rd/asset/model/icosphere_medium_lod1.mdl", GFX_UNUSED, false),
+        model_load_bin("/rd/asset/model/icosphere_medium_lod2.mdl", GFX_UNUSED, false)
+    };
+    float icosphere_thresholds[2] = {100.0f, 40.0f}; // Projected radius in pixels
+
+    model_mid_t icosphere_model = model_create_lod(icosphere_levels, icosphere_thresholds, 3);
+
+    mem_report();
+
+    // Don't run with half the assets, but still free the other half below
+    bool loaded = mem_get_failures() == 0 && font_texture != GFX_ERROR && earth_texture != GFX_ERROR &&
+                  uvsphere_model != MODEL_ERROR && icosphere_model != MODEL_ERROR;
+
+    if(loaded == false) {
+        debug_printf(DEBUG_ERROR, "Failed to load the demo assets (%d failed allocations), exiting.\n", (int)mem_get_failures());
+    }
 
     gfx_vram_info_t vram = {0};
 
 
 
-    while(1) {
+    while(loaded) {
 
         float scale  = 150.0f;
         float posx   = 320.0f;
         float posy   = 240.0f;
-        float posz   = 500.0f;
+
+        // Back and forth between 500 and 2500, so the icosphere goes from a
+        // projected radius of about 150 down to 30 pixels and through every LOD level
+        static float distance_phase = 0.0f;
 
         static gfx_color_t ambient_color     = {0xFFFFFFFF};
         static float       ambient_intensity = 0.1f;
@@ -57,7 +86,12 @@ int main(void)
         static vec3_t      point_position    = {320.0f, 200.0f, 800.0f};
 
 
-        controller_read_state();
+        prof_frame_begin();
+
+        PROF_SCOPE(PROF_INPUT) {
+            controller_read_state();
+        }
+
         if(controller_test_button(CONTROLLER_START, CONTROLLER_PRESSED)) {
             debug_printf(DEBUG_INFO, "Start was pressed. Exiting demo.\n");
             break;
@@ -103,6 +137,10 @@ int main(void)
             if(point_position.y > 480.0f) point_position.y = 480.0f;
         }
 
+        distance_phase += 0.005f;
+        if(distance_phase > MV_2PI) distance_phase -= MV_2PI;
+        float posz = 1500.0f - 1000.0f * fcos(distance_phase);
+
         mv_identity(); // start with identity matrix
 
 
@@ -122,22 +160,42 @@ int main(void)
             gfx_font_printf(font_texture, 16, 20, 20, "Ambient RGB: <%03d,%03d,%03d> @ %.1f%%", ambient_color.component.r, ambient_color.component.g, ambient_color.component.b, ambient_intensity * 100.0f);
             gfx_font_printf(font_texture, 16, 20, 40, "Point   RGB: <%03d,%03d,%03d> @ %.1f%%", point_color.component.r, point_color.component.g, point_color.component.b, point_intensity * 100.0f);
             gfx_font_printf(font_texture, 16, 20, 60, "Point   XYZ: <%03d,%03d,%03d>", (int)point_position.x, (int)point_position.y, (int)point_position.z);
+            gfx_font_printf(font_texture, 16, 20, 400, "LOD level: %d", (int)model_get(icosphere_model)->lod.current);
             gfx_font_printf(font_texture, 16, 20, 420, "Vertices: %4d", vram.vertex_count);
             gfx_font_printf(font_texture, 16, 20, 440, "Textures: %4d", vram.texture_count);
             gfx_font_printf(font_texture, 16, 350, 440, "VRAM: %6.2f KiB", (vram.vertex_memory + vram.texture_memory) / 1024.0f);
+
+            if(vram.vertex_dropped > 0) {
+                gfx_font_printf(font_texture, 16, 350, 420, "Dropped: %4d", vram.vertex_dropped);
+            }
+
+            prof_draw_overlay(font_texture, 20, 100);
         }
         gfx_end();
 
         vram = gfx_get_vram_info();
 
+        prof_frame_end();
+
+    }
+
+
+    prof_dump();
+
+    if(icosphere_model != MODEL_ERROR) {
+        model_free_obj(icosphere_model); // Along with its levels
+    } else {
+        for(int i = 0; i < 3; i++) {
+            if(icosphere_levels[i] != MODEL_ERROR) model_free_obj(icosphere_levels[i]);
+        }
     }
 
+    if(uvsphere_model != MODEL_ERROR) model_free_obj(uvsphere_model);
+    if(font_texture   != GFX_ERROR)   gfx_free_texture(font_texture);
+    if(earth_texture  != GFX_ERROR)   gfx_free_texture(earth_texture);
 
-    model_free_obj(icosphere_model);
-    model_free_obj(uvsphere_model);
-    gfx_free_texture(font_texture);
-    gfx_free_texture(earth_texture);
+    mem_report(); // Anything left here leaked
 
     debug_end();
-    return 0;
+    return loaded ? 0 : 1;
 }
@@ -0,0 +1,308 @@
+// ============================================================================
+// File:        mem.c
+// Description: Memory accounting related functionality (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#define DEBUG_CHANNEL DEBUG_CHANNEL_MEM
+
+#include "config.h"
+
+#include "mem.h"
+#include "debug.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <kos.h>
+
+#ifdef CONFIG_DEBUG_LOG_ENABLED
+static const char* tag_name[MEM_TAG_COUNT]   = { "Texture", "Model", "Scratch", "Log" };
+static const char* pool_name[MEM_POOL_COUNT] = { "RAM", "VRAM" };
+#endif
+
+static mem_usage_t usage[MEM_POOL_COUNT][MEM_TAG_COUNT];
+static mem_usage_t total[MEM_POOL_COUNT] = {
+    [MEM_POOL_RAM]  = { .budget = CONFIG_MEM_BUDGET_RAM },
+    [MEM_POOL_VRAM] = { .budget = CONFIG_MEM_BUDGET_VRAM },
+};
+static size_t      failures; // Allocations refused or failed, logged or not
+
+// After gfx_initialize, so the frame and TA buffers are already taken
+void mem_initialize(void)
+{
+    if(total[MEM_POOL_VRAM].budget == 0) {
+        total[MEM_POOL_VRAM].budget = pvr_mem_available();
+    }
+
+    debug_printf(DEBUG_INFO, "Initialized memory accounting.\n");
+    debug_printf(DEBUG_BLANK,"RAM budget:  %.1f KiB\n", CONFIG_MEM_BUDGET_RAM / 1024.0f);
+    debug_printf(DEBUG_BLANK,"VRAM budget: %.1f KiB\n", total[MEM_POOL_VRAM].budget / 1024.0f);
+    debug_printf(DEBUG_BLANK,"VRAM free:   %.1f KiB\n", pvr_mem_available() / 1024.0f);
+}
+
+static void add(mem_usage_t* u, size_t size)
+{
+    u->current += size;
+    u->allocations++;
+
+    if(u->current > u->peak) {
+        u->peak = u->current;
+    }
+}
+
+static void sub(mem_usage_t* u, size_t size)
+{
+    u->current -= size;
+    u->allocations--;
+}
+
+// Whether size more bytes fit the budgets, logs why not
+static bool fits(mem_tag_t tag, mem_pool_t pool, size_t size)
+{
+    const mem_usage_t* u = &usage[pool][tag];
+    const mem_usage_t* t = &total[pool];
+
+    if(u->budget != 0 && u->current + size > u->budget) {
+        failures++;
+        debug_printf(DEBUG_ERROR, "%s allocation of %d bytes exceeds the %s budget (%d of %d bytes used).\n",
+                     tag_name[tag], (int)size, pool_name[pool], (int)u->current, (int)u->budget);
+        mem_report();
+        return false;
+    }
+
+    if(t->budget != 0 && t->current + size > t->budget) {
+        failures++;
+        debug_printf(DEBUG_ERROR, "%s allocation of %d bytes exceeds the %s budget (%d of %d bytes used).\n",
+                     tag_name[tag], (int)size, pool_name[pool], (int)t->current, (int)t->budget);
+        mem_report();
+        return false;
+    }
+
+    return true;
+}
+
+static void failed(mem_tag_t tag, mem_pool_t pool, size_t size)
+{
+    (void)tag; (void)pool; (void)size;
+
+    failures++;
+    debug_printf(DEBUG_ERROR, "Out of %s for a %s allocation of %d bytes.\n", pool_name[pool], tag_name[tag], (int)size);
+    mem_report();
+}
+
+// ============================================================================
+// Main RAM
+// ============================================================================
+// Blocks are counted at their usable size, which is what free gives back.
+
+static void* track(mem_tag_t tag, void* p, size_t size)
+{
+    if(p == NULL) {
+        failed(tag, MEM_POOL_RAM, size);
+        return NULL;
+    }
+
+    size_t usable = malloc_usable_size(p);
+
+    add(&usage[MEM_POOL_RAM][tag], usable);
+    add(&total[MEM_POOL_RAM], usable);
+
+    return p;
+}
+
+void* mem_malloc(mem_tag_t tag, size_t size)
+{
+    if(fits(tag, MEM_POOL_RAM, size) == false) {
+        return NULL;
+    }
+
+    return track(tag, malloc(size), size);
+}
+
+void* mem_calloc(mem_tag_t tag, size_t count, size_t size)
+{
+    if(fits(tag, MEM_POOL_RAM, count * size) == false) {
+        return NULL;
+    }
+
+    return track(tag, calloc(count, size), count * size);
+}
+
+void* mem_memalign(mem_tag_t tag, size_t alignment, size_t size)
+{
+    if(fits(tag, MEM_POOL_RAM, size) == false) {
+        return NULL;
+    }
+
+    return track(tag, memalign(alignment, size), size);
+}
+
+void* mem_realloc(mem_tag_t tag, void* p, size_t size)
+{
+    if(p == NULL) {
+        return mem_malloc(tag, size);
+    }
+
+    size_t old = malloc_usable_size(p);
+
+    if(size > old && fits(tag, MEM_POOL_RAM, size - old) == false) {
+        return NULL;
+    }
+
+    void* q = realloc(p, size);
+
+    if(q == NULL) {
+        failed(tag, MEM_POOL_RAM, size);
+        return NULL; // p is still valid and counted
+    }
+
+    sub(&usage[MEM_POOL_RAM][tag], old);
+    sub(&total[MEM_POOL_RAM], old);
+
+    return track(tag, q, size);
+}
+
+void mem_free(mem_tag_t tag, void* p)
+{
+    if(p == NULL) {
+        return;
+    }
+
+    size_t usable = malloc_usable_size(p);
+
+    sub(&usage[MEM_POOL_RAM][tag], usable);
+    sub(&total[MEM_POOL_RAM], usable);
+
+    free(p);
+}
+
+// ============================================================================
+// PVR Memory
+// ============================================================================
+
+void* mem_pvr_malloc(mem_tag_t tag, size_t size)
+{
+    if(fits(tag, MEM_POOL_VRAM, size) == false) {
+        return NULL;
+    }
+
+    void* p = pvr_mem_malloc(size);
+
+    if(p == NULL) {
+        failed(tag, MEM_POOL_VRAM, size);
+        return NULL;
+    }
+
+    add(&usage[MEM_POOL_VRAM][tag], size);
+    add(&total[MEM_POOL_VRAM], size);
+
+    return p;
+}
+
+void mem_pvr_free(mem_tag_t tag, void* p, size_t size)
+{
+    if(p == NULL) {
+        return;
+    }
+
+    sub(&usage[MEM_POOL_VRAM][tag], size);
+    sub(&total[MEM_POOL_VRAM], size);
+
+    pvr_mem_free(p);
+}
+
+size_t mem_get_pvr_largest_block(void)
+{
+    // Binary search over 32 byte granules, the PVR allocator's alignment
+    size_t low  = 0;
+    size_t high = pvr_mem_available() / 32;
+
+    while(low < high) {
+        size_t mid = (low + high + 1) / 2;
+        void*  p   = pvr_mem_malloc(mid * 32);
+
+        if(p != NULL) {
+            pvr_mem_free(p);
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return low * 32;
+}
+
+float mem_get_pvr_fragmentation(void)
+{
+    size_t available = pvr_mem_available();
+
+    if(available == 0) {
+        return 0.0f;
+    }
+
+    return 1.0f - (float)mem_get_pvr_largest_block() / available;
+}
+
+// ============================================================================
+// Queries
+// ============================================================================
+
+void mem_set_budget(mem_tag_t tag, mem_pool_t pool, size_t budget)
+{
+    usage[pool][tag].budget = budget;
+}
+
+mem_usage_t mem_get_usage(mem_tag_t tag, mem_pool_t pool)
+{
+    return usage[pool][tag];
+}
+
+mem_usage_t mem_get_pool_usage(mem_pool_t pool)
+{
+    return total[pool];
+}
+
+size_t mem_get_failures(void)
+{
+    return failures;
+}
+
+void mem_report(void)
+{
+#ifdef CONFIG_DEBUG_LOG_ENABLED
+    debug_printf(DEBUG_INFO, "Memory usage (KiB):\n");
+    debug_printf(DEBUG_BLANK,"%-5s %-8s %9s %9s %9s %6s\n", "Pool", "Tag", "current", "peak", "budget", "blocks");
+
+    for(size_t pool = 0; pool < MEM_POOL_COUNT; pool++) {
+        for(size_t tag = 0; tag < MEM_TAG_COUNT; tag++) {
+            const mem_usage_t* u = &usage[pool][tag];
+            if(u->peak == 0) continue;
+
+            debug_printf(DEBUG_BLANK,"%-5s %-8s %9.1f %9.1f %9.1f %6d\n", pool_name[pool], tag_name[tag],
+                         u->current / 1024.0f, u->peak / 1024.0f, u->budget / 1024.0f, (int)u->allocations);
+        }
+
+        const mem_usage_t* t = &total[pool];
+        debug_printf(DEBUG_BLANK,"%-5s %-8s %9.1f %9.1f %9.1f %6d\n", pool_name[pool], "Total",
+                     t->current / 1024.0f, t->peak / 1024.0f, t->budget / 1024.0f, (int)t->allocations);
+    }
+
+    size_t available = pvr_mem_available();
+    size_t largest   = mem_get_pvr_largest_block();
+
+    debug_printf(DEBUG_BLANK,"VRAM free: %.1f KiB, largest block: %.1f KiB, fragmentation: %.0f%%\n",
+                 available / 1024.0f, largest / 1024.0f,
+                 available ? 100.0f * (1.0f - (float)largest / available) : 0.0f);
+
+#ifdef CONFIG_TARGET_SH4
+    struct mallinfo mi = mallinfo();
+    debug_printf(DEBUG_BLANK,"RAM heap: %.1f KiB in use, %.1f KiB free\n", mi.uordblks / 1024.0f, mi.fordblks / 1024.0f);
+#endif
+
+    if(failures != 0) {
+        debug_printf(DEBUG_BLANK,"Failed allocations: %d\n", (int)failures);
+    }
+#endif
+}
@@ -0,0 +1,72 @@
+// ============================================================================
+// File:        mem.h
+// Description: Memory accounting related functionality (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#ifndef MEM_H
+#define MEM_H
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum mem_tag_t
+{
+    MEM_TAG_TEXTURE, // Texture data
+    MEM_TAG_MODEL,   // Loaded model data
+    MEM_TAG_SCRATCH, // Load time temporaries and per draw working memory
+    MEM_TAG_LOG,     // Debug log buffers
+    MEM_TAG_COUNT
+} mem_tag_t;
+
+typedef enum mem_pool_t
+{
+    MEM_POOL_RAM,    // Main RAM, malloc
+    MEM_POOL_VRAM,   // PVR texture memory, pvr_mem_malloc
+    MEM_POOL_COUNT
+} mem_pool_t;
+
+typedef struct mem_usage_t
+{
+    size_t current;
+    size_t peak;        // High-water mark of current since startup
+    size_t budget;      // 0 when unlimited
+    size_t allocations; // Live allocations
+} mem_usage_t;
+
+void mem_initialize(void);
+
+// Counted against the tag and the RAM pool, sizes as reported by the allocator.
+// Failing allocations and ones past a budget return NULL and log a report.
+void* mem_malloc(mem_tag_t tag, size_t size);
+void* mem_calloc(mem_tag_t tag, size_t count, size_t size);
+void* mem_realloc(mem_tag_t tag, void* p, size_t size);
+void* mem_memalign(mem_tag_t tag, size_t alignment, size_t size);
+void  mem_free(mem_tag_t tag, void* p);
+
+// The PVR allocator can't tell a block's size, so it is passed back on free
+void* mem_pvr_malloc(mem_tag_t tag, size_t size);
+void  mem_pvr_free(mem_tag_t tag, void* p, size_t size);
+
+// Pool budgets start at CONFIG_MEM_BUDGET_RAM/VRAM, tag budgets unlimited.
+// A VRAM budget of 0 becomes the PVR memory free at mem_initialize.
+void        mem_set_budget(mem_tag_t tag, mem_pool_t pool, size_t budget);
+mem_usage_t mem_get_usage(mem_tag_t tag, mem_pool_t pool);
+mem_usage_t mem_get_pool_usage(mem_pool_t pool);
+
+// Allocations refused by a budget or failed by the allocator since startup.
+// Without the debug log nothing else reports them, so check it after loading.
+size_t      mem_get_failures(void);
+
+// Largest block pvr_mem_malloc could return right now, found by probing.
+// Fragmentation is the share of free PVR memory outside that block.
+size_t mem_get_pvr_largest_block(void);
+float  mem_get_pvr_fragmentation(void);
+
+void mem_report(void);
+
+
+#endif // MEM_H
@@ -5,227 +5,1324 @@
 // Date:        2023/12/05
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_MODEL
+
 #include "config.h"
 #include "model.h"
 #include "debug.h"
 
-#include "mv.h"
+#include "mv.h"
+#include "strip.h"
+#include "cluster.h"
+#include "prof.h"
+#include "mem.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "light.h" // TODO: Fix this hardcoded reest
+
+
+static model_t model[CONFIG_MAX_MODELS];
+static bool    model_occupied[CONFIG_MAX_MODELS];
+static size_t  model_count;
+
+// Piece of a strip where every triangle faces the viewer
+typedef struct model_run_t
+{
+    const uint16_t* indices;
+    size_t          count;
+} model_run_t;
+
+// Per draw working memory, shared by all models and grown to fit the largest
+static gfx_vertex_t* scratch;        // Transformed and lit vertices
+static uint32_t*     scratch_stamp;  // Last draw that used each vertex
+static uint16_t*     scratch_used;   // Vertices used by the current draw
+static model_run_t*  scratch_runs;
+static size_t        scratch_vertices;
+static size_t        scratch_triangles;
+static uint32_t      scratch_draw;
+
+static bool scratch_reserve(size_t vertex_count, size_t triangle_count)
+{
+    if(vertex_count > scratch_vertices) {
+        gfx_vertex_t* p = mem_realloc(MEM_TAG_SCRATCH, scratch, sizeof(gfx_vertex_t) * vertex_count);
+        uint16_t*     u = mem_realloc(MEM_TAG_SCRATCH, scratch_used, sizeof(uint16_t) * vertex_count);
+        uint32_t*     t = mem_calloc(MEM_TAG_SCRATCH, vertex_count, sizeof(uint32_t));
+
+        if(p != NULL) scratch      = p;
+        if(u != NULL) scratch_used = u;
+
+        if(p == NULL || u == NULL || t == NULL) {
+            debug_printf(DEBUG_ERROR, "Failed to allocate %d transformed vertices.\n", vertex_count);
+            mem_free(MEM_TAG_SCRATCH, t);
+            return false;
+        }
+
+        mem_free(MEM_TAG_SCRATCH, scratch_stamp);
+        scratch_stamp    = t;
+        scratch_draw     = 0;
+        scratch_vertices = vertex_count;
+    }
+
+    if(triangle_count > scratch_triangles) {
+        model_run_t* r = mem_realloc(MEM_TAG_SCRATCH, scratch_runs, sizeof(model_run_t) * triangle_count);
+
+        if(r == NULL) {
+            debug_printf(DEBUG_ERROR, "Failed to allocate %d strip runs.\n", triangle_count);
+            return false;
+        }
+
+        scratch_runs      = r;
+        scratch_triangles = triangle_count;
+    }
+
+    return true;
+}
+
+// Indexed mesh as produced by the loaders, before it becomes a model
+typedef struct mesh_t
+{
+    gfx_vertex_t* vertices;
+    vec3_t*       normals;
+    uint16_t*     indices;      // Three per triangle
+    size_t        vertex_count;
+    size_t        index_count;
+    bool          prelit;       // Vertex colors hold baked lighting
+} mesh_t;
+
+// Vertex i of a model is vertex map[i] of the mesh it was made from, or
+// vertex i if there is no map
+INLINE size_t mesh_index(const uint16_t* map, size_t i)
+{
+    return (map != NULL) ? map[i] : i;
+}
+
+// Rounds an offset up to the next 32-byte boundary (a cache line)
+#define MODEL_ALIGN(x) (((x) + 31) & ~(size_t)31)
+
+// Bounds of the given vertices, or of vertices[map[0..count-1]] if map is set
+static void compute_bounds(const gfx_vertex_t* vertices, const uint16_t* map, size_t count, model_bounds_t* b)
+{
+    #define POSITION(i) (vertices[(map != NULL) ? map[i] : (i)].position)
+
+    b->min = b->max = b->center = (vec3_t){0.0f, 0.0f, 0.0f};
+    b->radius = 0.0f;
+
+    if(count == 0) {
+        return;
+    }
+
+    b->min = b->max = POSITION(0);
+
+    for(size_t i = 1; i < count; i++) {
+        vec3_t p = POSITION(i);
+        if(p.x < b->min.x) b->min.x = p.x;
+        if(p.y < b->min.y) b->min.y = p.y;
+        if(p.z < b->min.z) b->min.z = p.z;
+        if(p.x > b->max.x) b->max.x = p.x;
+        if(p.y > b->max.y) b->max.y = p.y;
+        if(p.z > b->max.z) b->max.z = p.z;
+    }
+
+    b->center = mv_vec_scale(mv_vec_add(b->min, b->max), 0.5f);
+
+    float radius_sq = 0.0f;
+
+    for(size_t i = 0; i < count; i++) {
+        vec3_t d = mv_vec_sub(POSITION(i), b->center);
+        float  l = mv_vec_scalar_product(d, d);
+        if(l > radius_sq) radius_sq = l;
+    }
+
+    b->radius = fsqrt(radius_sq);
+
+    #undef POSITION
+}
+
+// ============================================================================
+// Vertex Access - Hides whether vertices are stored quantized or not
+// ============================================================================
+
+#ifdef CONFIG_MODEL_QUANTIZED
+
+INLINE int16_t quantize(float x)
+{
+    x = (x < 0.0f) ? x - 0.5f : x + 0.5f;
+    if(x < -32768.0f) return -32768;
+    if(x >  32767.0f) return  32767;
+    return (int16_t)x;
+}
+
+// Octahedral mapping: the normal is projected onto an octahedron, which is
+// then unfolded into a square and stored as two 8-bit coordinates.
+static uint16_t oct_encode(vec3_t n)
+{
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+
+    if(l1 == 0.0f) {
+        return 0x8080;
+    }
+
+    float x = n.x / l1;
+    float y = n.y / l1;
+
+    if(n.z < 0.0f) {
+        float ox = x;
+        x = (1.0f - fabsf(y))  * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(ox)) * (y  >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    uint16_t qx = (uint16_t)((x * 0.5f + 0.5f) * 255.0f + 0.5f);
+    uint16_t qy = (uint16_t)((y * 0.5f + 0.5f) * 255.0f + 0.5f);
+
+    return qx | (qy << 8);
+}
+
+INLINE vec3_t oct_decode(uint16_t e)
+{
+    float x = (float)(e & 0xFF) * (2.0f / 255.0f) - 1.0f;
+    float y = (float)(e >> 8)   * (2.0f / 255.0f) - 1.0f;
+    float z = 1.0f - fabsf(x) - fabsf(y);
+
+    if(z < 0.0f) {
+        float ox = x;
+        x = (1.0f - fabsf(y))  * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(ox)) * (y  >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    return mv_vec_scale((vec3_t){x, y, z}, frsqrt(x * x + y * y + z * z));
+}
+
+// Positions are stored relative to the center of the bounding box, scaled so
+// the box fills the whole int16 range on every axis, and texture coordinates
+// the same way within their own range, so tiled UVs keep their precision.
+// Vertex i of the model is vertex mesh_index(map, i) of the mesh.
+static void store_vertices(model_t* m, const mesh_t* mesh, const uint16_t* map)
+{
+    vec3_t half = mv_vec_scale(mv_vec_sub(m->bounds.max, m->bounds.min), 0.5f);
+
+    m->offset  = mv_vec_scale(mv_vec_add(m->bounds.max, m->bounds.min), 0.5f);
+    m->scale.x = (half.x > 0.0f) ? half.x / 32767.0f : 1.0f;
+    m->scale.y = (half.y > 0.0f) ? half.y / 32767.0f : 1.0f;
+    m->scale.z = (half.z > 0.0f) ? half.z / 32767.0f : 1.0f;
+
+    float uv_min[2] = {INFINITY, INFINITY}, uv_max[2] = {-INFINITY, -INFINITY};
+
+    for(size_t i = 0; i < m->vertex_count; i++) {
+        const gfx_vertex_t* v = &mesh->vertices[mesh_index(map, i)];
+        uv_min[0] = fminf(uv_min[0], v->u);
+        uv_max[0] = fmaxf(uv_max[0], v->u);
+        uv_min[1] = fminf(uv_min[1], v->v);
+        uv_max[1] = fmaxf(uv_max[1], v->v);
+    }
+
+    for(int k = 0; k < 2; k++) {
+        float uv_half = (m->vertex_count > 0) ? 0.5f * (uv_max[k] - uv_min[k]) : 0.0f;
+
+        m->uv_offset[k] = (m->vertex_count > 0) ? 0.5f * (uv_max[k] + uv_min[k]) : 0.0f;
+        m->uv_scale[k]  = (uv_half > 0.0f) ? uv_half / 32767.0f : 1.0f;
+    }
+
+    for(size_t i = 0; i < m->vertex_count; i++) {
+        const gfx_vertex_t* v = &mesh->vertices[mesh_index(map, i)];
+        model_qvertex_t*    q = &m->vertices[i];
+
+        q->x      = quantize((v->position.x - m->offset.x) / m->scale.x);
+        q->y      = quantize((v->position.y - m->offset.y) / m->scale.y);
+        q->z      = quantize((v->position.z - m->offset.z) / m->scale.z);
+        q->normal = oct_encode(mesh->normals[mesh_index(map, i)]);
+        q->u      = quantize((v->u - m->uv_offset[0]) / m->uv_scale[0]);
+        q->v      = quantize((v->v - m->uv_offset[1]) / m->uv_scale[1]);
+    }
+}
+
+INLINE vec3_t model_vertex_normal(const model_t* m, size_t i)
+{
+    return oct_decode(m->vertices[i].normal);
+}
+
+INLINE vec3_t model_vertex_position(const model_t* m, size_t i)
+{
+    return (vec3_t){m->vertices[i].x * m->scale.x + m->offset.x,
+                    m->vertices[i].y * m->scale.y + m->offset.y,
+                    m->vertices[i].z * m->scale.z + m->offset.z};
+}
+
+// Writes texture coordinates and the stored color into out
+INLINE void model_vertex_attributes(const model_t* m, size_t i, gfx_vertex_t* out)
+{
+    out->u          = m->vertices[i].u * m->uv_scale[0] + m->uv_offset[0];
+    out->v          = m->vertices[i].v * m->uv_scale[1] + m->uv_offset[1];
+    out->color.argb = 0x00000000;
+}
+
+INLINE void model_transform_vertices(const model_t* m, const uint16_t* indices, size_t count, gfx_vertex_t* out)
+{
+    mv_transform_batch_s16_indexed(&m->vertices[0].x, sizeof(model_qvertex_t), m->scale, m->offset,
+                                   &out[0].position,  sizeof(gfx_vertex_t), indices, count);
+}
+
+#else
+
+// Normals are normalized here, so lighting doesn't need to
+static void store_vertices(model_t* m, const mesh_t* mesh, const uint16_t* map)
+{
+    for(size_t i = 0; i < m->vertex_count; i++) {
+        vec3_t n = mesh->normals[mesh_index(map, i)];
+        float  l = mv_vec_scalar_product(n, n);
+
+        m->vertices[i] = mesh->vertices[mesh_index(map, i)];
+        m->normals[i]  = (l > 0.0f) ? mv_vec_scale(n, frsqrt(l)) : n;
+    }
+}
+
+INLINE vec3_t model_vertex_normal(const model_t* m, size_t i)
+{
+    return m->normals[i];
+}
+
+INLINE vec3_t model_vertex_position(const model_t* m, size_t i)
+{
+    return m->vertices[i].position;
+}
+
+// Writes texture coordinates and the stored color into out
+INLINE void model_vertex_attributes(const model_t* m, size_t i, gfx_vertex_t* out)
+{
+    out->u     = m->vertices[i].u;
+    out->v     = m->vertices[i].v;
+    out->color = m->vertices[i].color;
+}
+
+INLINE void model_transform_vertices(const model_t* m, const uint16_t* indices, size_t count, gfx_vertex_t* out)
+{
+    mv_transform_batch_indexed(&m->vertices[0].position, sizeof(gfx_vertex_t),
+                               &out[0].position,         sizeof(gfx_vertex_t), indices, count);
+}
+
+#endif // CONFIG_MODEL_QUANTIZED
+
+// Plane of every triangle of the strips, with the normal given by the
+// triangle's winding. Left unnormalized, only the sign of a test matters.
+static void compute_planes(model_t* m, const mesh_t* mesh, const uint16_t* map)
+{
+    const uint16_t* strip = m->strips;
+    mv_plane_t*     plane = m->planes;
+
+    for(size_t i = 0; i < m->strip_count; i++) {
+        for(size_t j = 0; j + 2 < m->strip_lengths[i]; j++) {
+            // Odd triangles of a strip have their first two vertices swapped
+            vec3_t a = mesh->vertices[map[strip[j + ((j & 1) ? 1 : 0)]]].position;
+            vec3_t b = mesh->vertices[map[strip[j + ((j & 1) ? 0 : 1)]]].position;
+            vec3_t c = mesh->vertices[map[strip[j + 2]]].position;
+
+            plane->normal   = mv_vec_cross_product(mv_vec_sub(b, a), mv_vec_sub(c, a));
+            plane->distance = -mv_vec_scalar_product(plane->normal, a);
+            plane++;
+        }
+
+        strip += m->strip_lengths[i];
+    }
+}
+
+// Points the arrays of a model into a single new allocation sized for the
+// given counts, and sets those counts
+static bool model_allocate(model_t* m, size_t vertex_count, size_t strip_index_count, size_t strip_count,
+                           size_t cluster_count, bool lit, bool prelit)
+{
+#ifdef CONFIG_MODEL_QUANTIZED
+    size_t vertex_offset = 0;
+    size_t strip_offset  = MODEL_ALIGN(vertex_offset + sizeof(model_qvertex_t) * vertex_count);
+#else
+    size_t vertex_offset = 0;
+    size_t normal_offset = MODEL_ALIGN(vertex_offset + sizeof(gfx_vertex_t) * vertex_count);
+    size_t strip_offset  = MODEL_ALIGN(normal_offset + sizeof(vec3_t) * vertex_count);
+#endif
+    size_t plane_offset   = MODEL_ALIGN(strip_offset   + sizeof(uint16_t) * strip_index_count);
+    size_t length_offset  = MODEL_ALIGN(plane_offset   + sizeof(mv_plane_t) * (strip_index_count - 2 * strip_count));
+    size_t cluster_offset = MODEL_ALIGN(length_offset  + sizeof(uint16_t) * strip_count);
+    size_t color_offset   = MODEL_ALIGN(cluster_offset + sizeof(model_cluster_t) * cluster_count);
+    size_t stamp_offset   = MODEL_ALIGN(color_offset   + (lit ? sizeof(gfx_color_t) * vertex_count : 0));
+    size_t size           = MODEL_ALIGN(stamp_offset   + (lit && !prelit ? sizeof(uint32_t) * vertex_count : 0));
+
+    if((m->data = mem_memalign(MEM_TAG_MODEL, 32, size)) == NULL) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model.\n");
+        return false;
+    }
+
+    uint8_t* data = (uint8_t*)m->data;
+
+    m->strips            = (uint16_t*)(data + strip_offset);
+    m->strip_lengths     = (uint16_t*)(data + length_offset);
+    m->planes            = (mv_plane_t*)(data + plane_offset);
+    m->clusters          = (model_cluster_t*)(data + cluster_offset);
+    m->colors            = lit ? (gfx_color_t*)(data + color_offset) : NULL;
+    m->color_stamps      = lit && !prelit ? (uint32_t*)(data + stamp_offset) : NULL;
+    m->color_generation  = 1; // No color is valid yet
+    m->data_size         = size;
+    m->vertex_count      = vertex_count;
+    m->strip_index_count = strip_index_count;
+    m->strip_count       = strip_count;
+    m->cluster_count     = cluster_count;
+    m->prelit            = prelit;
+
+#ifdef CONFIG_MODEL_QUANTIZED
+    m->vertices = (model_qvertex_t*)(data + vertex_offset);
+#else
+    m->vertices = (gfx_vertex_t*)(data + vertex_offset);
+    m->normals  = (vec3_t*)(data + normal_offset);
+#endif
+
+    if(m->color_stamps != NULL) {
+        memset(m->color_stamps, 0, sizeof(uint32_t) * vertex_count);
+    }
+
+    return true;
+}
+
+// Gives a filled in model a free slot
+static model_mid_t model_register(const char* asset, const model_t* m)
+{
+    (void)asset; // Only logged
+
+    model_mid_t mid = 0;
+
+    while(model_occupied[mid] == true) {
+        mid++;
+    }
+
+    model_occupied[mid] = true;
+
+    model_count++;
+
+    model[mid]     = *m;
+    model[mid].mid = mid;
+
+    debug_printf(DEBUG_INFO, "Loaded model (mid = %d)\n", mid);
+    debug_printf(DEBUG_BLANK,"Asset: %s\n", asset);
+    debug_printf(DEBUG_BLANK,"Vertices: %d   Triangles: %d   Strips: %d   Strip indices: %d   Clusters: %d\n", m->vertex_count, m->triangle_count, m->strip_count, m->strip_index_count, m->cluster_count);
+
+    debug_printf(DEBUG_INFO, "Active models: %d\n", model_count);
+    debug_printf(DEBUG_BLANK, "Model memory used: %.1f KiB\n", mem_get_usage(MEM_TAG_MODEL, MEM_POOL_RAM).current / 1024.0f);
+
+    return mid;
+}
+
+// Turns an indexed mesh into a model: splits it into culling clusters, strips
+// every cluster, packs every array into one allocation and takes a free model
+// slot. The mesh is left untouched. Binary models come with all of this done,
+// see model_load_bin.
+static model_mid_t model_create(const char* asset, const mesh_t* mesh, gfx_tid_t tid, bool textured)
+{
+    if(model_count >= CONFIG_MAX_MODELS) {
+        debug_printf(DEBUG_ERROR, "Cannot allocate more than %d models.\n", CONFIG_MAX_MODELS);
+        return MODEL_ERROR;
+    }
+
+    model_t        m = {0};
+    cluster_list_t c;
+
+    if(cluster_build(mesh->indices, mesh->index_count / 3, mesh->vertex_count,
+                     CONFIG_MODEL_CLUSTER_SIZE, &c) == false) {
+        return MODEL_ERROR;
+    }
+
+    strip_list_t* strips = mem_calloc(MEM_TAG_SCRATCH, c.cluster_count + 1, sizeof(strip_list_t));
+
+    if(strips == NULL) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model.\n");
+        cluster_free(&c);
+        return MODEL_ERROR;
+    }
+
+    size_t strip_index_count = 0;
+    size_t strip_count       = 0;
+
+    for(size_t i = 0; i < c.cluster_count; i++) {
+        const cluster_range_t* r = &c.clusters[i];
+
+        if(strip_build(&c.indices[3 * r->first_triangle], r->triangle_count, &strips[i]) == false) {
+            for(size_t j = 0; j < i; j++) {
+                strip_free(&strips[j]);
+            }
+            mem_free(MEM_TAG_SCRATCH, strips);
+            cluster_free(&c);
+            return MODEL_ERROR;
+        }
+
+        strip_index_count += strips[i].index_count;
+        strip_count       += strips[i].strip_count;
+    }
+
+    compute_bounds(mesh->vertices, NULL, mesh->vertex_count, &m.bounds);
+
+    bool lit    = (textured == false || tid == GFX_UNUSED); // Drawn with vertex colors rather than a texture
+    bool prelit = lit && mesh->prelit;
+
+    if(model_allocate(&m, c.vertex_count, strip_index_count, strip_count, c.cluster_count, lit, prelit) == false) {
+        for(size_t i = 0; i < c.cluster_count; i++) {
+            strip_free(&strips[i]);
+        }
+        mem_free(MEM_TAG_SCRATCH, strips);
+        cluster_free(&c);
+        return MODEL_ERROR;
+    }
+
+    m.triangle_count = mesh->index_count / 3;
+    m.tid            = textured ? tid : GFX_UNUSED;
+    m.textured       = textured;
+
+    store_vertices(&m, mesh, c.vertex_map);
+
+    // Baked colors never change, so they simply are the cache
+    if(prelit == true) {
+        for(size_t i = 0; i < m.vertex_count; i++) {
+            m.colors[i] = mesh->vertices[c.vertex_map[i]].color;
+        }
+    }
+
+    size_t first_index = 0;
+    size_t first_strip = 0;
+
+    for(size_t i = 0; i < c.cluster_count; i++) {
+        const cluster_range_t* r  = &c.clusters[i];
+        model_cluster_t*       mc = &m.clusters[i];
+        model_bounds_t         b;
+
+        compute_bounds(mesh->vertices, &c.vertex_map[r->first_vertex], r->vertex_count, &b);
+
+        mc->center       = b.center;
+        mc->radius       = b.radius;
+        mc->first_index  = (uint32_t)first_index;
+        mc->first_strip  = (uint32_t)first_strip;
+        mc->strip_count  = (uint32_t)strips[i].strip_count;
+        mc->first_vertex = (uint16_t)r->first_vertex;
+        mc->vertex_count = (uint16_t)r->vertex_count;
+
+        memcpy(&m.strips[first_index],        strips[i].indices, sizeof(uint16_t) * strips[i].index_count);
+        memcpy(&m.strip_lengths[first_strip], strips[i].lengths, sizeof(uint16_t) * strips[i].strip_count);
+
+        first_index += strips[i].index_count;
+        first_strip += strips[i].strip_count;
+
+        strip_free(&strips[i]);
+    }
+
+    mem_free(MEM_TAG_SCRATCH, strips);
+
+    compute_planes(&m, mesh, c.vertex_map);
+
+    cluster_free(&c);
+
+    return model_register(asset, &m);
+}
+
+// ============================================================================
+// Vertex Deduplication - Maps OBJ v/vt/vn triples to unique vertex indices
+// ============================================================================
+
+typedef struct vertex_key_t
+{
+    size_t v, vt, vn; // 1-based, as in the OBJ file
+} vertex_key_t;
+
+typedef struct vertex_table_t
+{
+    uint32_t*     slots; // Vertex index + 1, 0 when empty
+    vertex_key_t* keys;  // Key of each unique vertex
+    size_t        mask;
+    size_t        count;
+} vertex_table_t;
+
+static bool vertex_table_create(vertex_table_t* t, size_t max_keys)
+{
+    size_t slot_count = 16;
+
+    while(slot_count < max_keys * 2) {
+        slot_count *= 2;
+    }
+
+    t->slots = mem_calloc(MEM_TAG_SCRATCH, slot_count, sizeof(uint32_t));
+    t->keys  = mem_malloc(MEM_TAG_SCRATCH, sizeof(vertex_key_t) * (max_keys > 0 ? max_keys : 1));
+    t->mask  = slot_count - 1;
+    t->count = 0;
+
+    if(t->slots == NULL || t->keys == NULL) {
+        mem_free(MEM_TAG_SCRATCH, t->slots);
+        mem_free(MEM_TAG_SCRATCH, t->keys);
+        return false;
+    }
+
+    return true;
+}
+
+static void vertex_table_destroy(vertex_table_t* t)
+{
+    mem_free(MEM_TAG_SCRATCH, t->slots);
+    mem_free(MEM_TAG_SCRATCH, t->keys);
+}
+
+// Returns the vertex index for the key, or count if the key is new
+static size_t vertex_table_insert(vertex_table_t* t, vertex_key_t k)
+{
+    size_t h = ((k.v * 73856093u) ^ (k.vt * 19349663u) ^ (k.vn * 83492791u)) & t->mask;
+
+    while(t->slots[h] != 0) {
+        vertex_key_t* e = &t->keys[t->slots[h] - 1];
+        if(e->v == k.v && e->vt == k.vt && e->vn == k.vn) {
+            return t->slots[h] - 1;
+        }
+        h = (h + 1) & t->mask;
+    }
+
+    t->keys[t->count] = k;
+    t->slots[h] = (uint32_t)(t->count + 1);
+
+    return t->count++;
+}
+
+void model_initialize(void)
+{
+    for(int i = 0; i < CONFIG_MAX_MODELS; i++) {
+        model_t m = {0};
+        model[i] = m;
+        model_occupied[i] = false;
+    }
+
+    model_count  = 0;
+
+    debug_printf(DEBUG_INFO, "Initialized model manager.\n");
+    debug_printf(DEBUG_BLANK,"Model limit: %d\n", CONFIG_MAX_MODELS);
+}
+
+
+// ============================================================================
+// OBJ Models - Single pass over the file, read in large chunks
+// ============================================================================
+// Attributes go into growable arrays and face corners are kept as raw index
+// triples, so faces may reference attributes defined further down the file.
+// Corners are only resolved and deduplicated once the whole file is read.
+// Supported faces are v, v/vt, v//vn and v/vt/vn with any number of corners
+// (fan triangulated). Corners without a normal get a smooth normal.
+
+#define OBJ_CHUNK_SIZE (32 * 1024) // Also the longest line that can be read
+
+typedef struct obj_array_t
+{
+    void*  data;
+    size_t count;
+    size_t capacity;
+    size_t stride;
+} obj_array_t;
+
+typedef struct obj_corner_t
+{
+    int32_t v, vt, vn; // 1-based and absolute, 0 when absent
+} obj_corner_t;
+
+typedef struct obj_state_t
+{
+    obj_array_t positions; // vec3_t
+    obj_array_t uvs;       // float[2]
+    obj_array_t normals;   // vec3_t
+    obj_array_t corners;   // obj_corner_t, three per triangle
+    size_t      face_count;
+    size_t      line;
+} obj_state_t;
+
+static void* obj_array_push(obj_array_t* a)
+{
+    if(a->count == a->capacity) {
+        size_t capacity = a->capacity ? a->capacity * 2 : 1024;
+        void*  data     = mem_realloc(MEM_TAG_SCRATCH, a->data, capacity * a->stride);
+
+        if(data == NULL) {
+            return NULL;
+        }
+
+        a->data     = data;
+        a->capacity = capacity;
+    }
+
+    return (uint8_t*)a->data + (a->count++ * a->stride);
+}
+
+// Locale independent and without the overhead of sscanf. Keeps the first nine
+// significant digits, which is more than a float can hold anyway.
+static const char* obj_scan_float(const char* p, float* out)
+{
+    static const float pow10[] = { 1e0f,  1e1f,  1e2f,  1e3f,  1e4f,  1e5f,  1e6f,  1e7f,
+                                   1e8f,  1e9f,  1e10f, 1e11f, 1e12f, 1e13f, 1e14f, 1e15f,
+                                   1e16f, 1e17f, 1e18f, 1e19f, 1e20f, 1e21f, 1e22f, 1e23f,
+                                   1e24f, 1e25f, 1e26f, 1e27f, 1e28f, 1e29f, 1e30f, 1e31f,
+                                   1e32f, 1e33f, 1e34f, 1e35f, 1e36f, 1e37f, 1e38f };
+
+    bool     negative = false;
+    uint32_t mantissa = 0;
+    int      exponent = 0;
+    int      digits   = 0;
+
+    while(*p == ' ' || *p == '\t') p++;
+
+    if(*p == '-') {
+        negative = true;
+        p++;
+    } else if(*p == '+') {
+        p++;
+    }
+
+    for(; *p >= '0' && *p <= '9'; p++, digits++) {
+        if(mantissa < 100000000u) {
+            mantissa = (mantissa * 10) + (*p - '0');
+        } else {
+            exponent++;
+        }
+    }
+
+    if(*p == '.') {
+        for(p++; *p >= '0' && *p <= '9'; p++, digits++) {
+            if(mantissa < 100000000u) {
+                mantissa = (mantissa * 10) + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+
+    if(digits == 0) {
+        return NULL;
+    }
+
+    if(*p == 'e' || *p == 'E') {
+        bool e_negative = false;
+        int  e          = 0;
+
+        p++;
+        if(*p == '-') {
+            e_negative = true;
+            p++;
+        } else if(*p == '+') {
+            p++;
+        }
+
+        for(; *p >= '0' && *p <= '9'; p++) {
+            if(e < 1000) e = (e * 10) + (*p - '0');
+        }
+
+        exponent += e_negative ? -e : e;
+    }
+
+    float value = (float)mantissa;
+
+    if(mantissa != 0) {
+        while(exponent > 38)  { value *= 1e38f; exponent -= 38; }
+        while(exponent < -38) { value /= 1e38f; exponent += 38; }
+        value = (exponent >= 0) ? value * pow10[exponent] : value / pow10[-exponent];
+    }
+
+    *out = negative ? -value : value;
+
+    return p;
+}
+
+static const char* obj_scan_int(const char* p, int32_t* out)
+{
+    bool    negative = false;
+    int32_t value    = 0;
+
+    if(*p == '-') {
+        negative = true;
+        p++;
+    }
+
+    if(*p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    for(; *p >= '0' && *p <= '9'; p++) {
+        if(value < 100000000) value = (value * 10) + (*p - '0');
+    }
+
+    *out = negative ? -value : value;
+
+    return p;
+}
+
+// Turns a relative (negative) OBJ index into an absolute one
+static int32_t obj_absolute(int32_t index, size_t count)
+{
+    return (index < 0) ? (int32_t)count + index + 1 : index;
+}
+
+static bool obj_parse_floats(const char* p, float* out, int count)
+{
+    for(int i = 0; i < count; i++) {
+        if((p = obj_scan_float(p, &out[i])) == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool obj_parse_face(obj_state_t* s, const char* p)
+{
+    obj_corner_t first = {0}, previous = {0};
+    int          count = 0;
+
+    for(;;) {
+        obj_corner_t c = {0, 0, 0};
+
+        while(*p == ' ' || *p == '\t') p++;
+
+        if(*p == '\0' || *p == '\r' || *p == '#') {
+            break;
+        }
+
+        if((p = obj_scan_int(p, &c.v)) == NULL) {
+            return false;
+        }
+
+        if(*p == '/') {
+            p++;
+            if(*p != '/' && (p = obj_scan_int(p, &c.vt)) == NULL) {
+                return false;
+            }
+            if(*p == '/' && (p = obj_scan_int(p + 1, &c.vn)) == NULL) {
+                return false;
+            }
+        }
+
+        c.v  = obj_absolute(c.v,  s->positions.count);
+        c.vt = obj_absolute(c.vt, s->uvs.count);
+        c.vn = obj_absolute(c.vn, s->normals.count);
+
+        // Fan triangulation: {first, previous, current} for every corner past the second
+        if(count >= 2) {
+            obj_corner_t* t = NULL;
+            for(int i = 0; i < 3; i++) {
+                if((t = obj_array_push(&s->corners)) == NULL) {
+                    return false;
+                }
+                *t = (i == 0) ? first : (i == 1) ? previous : c;
+            }
+        }
+
+        if(count == 0) {
+            first = c;
+        }
+
+        previous = c;
+        count++;
+    }
+
+    s->face_count++;
+
+    return count >= 3;
+}
+
+static bool obj_parse_line(obj_state_t* s, const char* p)
+{
+    while(*p == ' ' || *p == '\t') p++;
+
+    if(p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+        vec3_t* v = obj_array_push(&s->positions);
+        return v != NULL && obj_parse_floats(p + 2, &v->x, 3);
+    }
+    else if(p[0] == 'v' && p[1] == 't') {
+        float* uv = obj_array_push(&s->uvs);
+        return uv != NULL && obj_parse_floats(p + 2, uv, 2);
+    }
+    else if(p[0] == 'v' && p[1] == 'n') {
+        vec3_t* n = obj_array_push(&s->normals);
+        return n != NULL && obj_parse_floats(p + 2, &n->x, 3);
+    }
+    else if(p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+        return obj_parse_face(s, p + 2);
+    }
+
+    return true; // Comments, groups, materials, smoothing... are ignored
+}
+
+// Area weighted average of the normals of all faces around each position
+static vec3_t* obj_smooth_normals(const obj_state_t* s)
+{
+    const vec3_t*       p = (const vec3_t*)s->positions.data;
+    const obj_corner_t* c = (const obj_corner_t*)s->corners.data;
+    vec3_t*             n = mem_calloc(MEM_TAG_SCRATCH, s->positions.count + 1, sizeof(vec3_t));
+
+    if(n == NULL) {
+        return NULL;
+    }
+
+    for(size_t i = 0; i < s->corners.count; i += 3) {
+        vec3_t a = p[c[i].v - 1];
+        vec3_t b = p[c[i+1].v - 1];
+        vec3_t d = p[c[i+2].v - 1];
+        vec3_t f = mv_vec_cross_product(mv_vec_sub(b, a), mv_vec_sub(d, a));
+
+        for(int k = 0; k < 3; k++) {
+            n[c[i+k].v - 1] = mv_vec_add(n[c[i+k].v - 1], f);
+        }
+    }
+
+    for(size_t i = 0; i < s->positions.count; i++) {
+        if(mv_vec_scalar_product(n[i], n[i]) > 0.0f) {
+            n[i] = mv_vec_normalize(n[i]);
+        }
+    }
+
+    return n;
+}
+
+static void obj_state_free(obj_state_t* s)
+{
+    mem_free(MEM_TAG_SCRATCH, s->positions.data);
+    mem_free(MEM_TAG_SCRATCH, s->uvs.data);
+    mem_free(MEM_TAG_SCRATCH, s->normals.data);
+    mem_free(MEM_TAG_SCRATCH, s->corners.data);
+}
+
+model_mid_t model_load_obj(const char* asset, gfx_tid_t tid, bool textured)
+{
+    if(model_count >= CONFIG_MAX_MODELS) {
+        debug_printf(DEBUG_ERROR, "Cannot allocate more than %d models.\n", CONFIG_MAX_MODELS);
+        return MODEL_ERROR;
+    }
+
+    FILE*       f      = NULL;
+    char*       buffer = NULL;
+    obj_state_t s;
+    bool        valid  = true;
+
+    memset(&s, 0, sizeof(s));
+    s.positions.stride = sizeof(vec3_t);
+    s.uvs.stride       = sizeof(float) * 2;
+    s.normals.stride   = sizeof(vec3_t);
+    s.corners.stride   = sizeof(obj_corner_t);
+
+    if((f = fopen(asset, "rb")) == NULL) {
+        debug_printf(DEBUG_ERROR, "Couldn't open specified model: %s\n", asset);
+        return MODEL_ERROR;
+    }
+
+    if((buffer = mem_malloc(MEM_TAG_SCRATCH, OBJ_CHUNK_SIZE + 1)) == NULL) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model file buffer.\n");
+        fclose(f);
+        return MODEL_ERROR;
+    }
+
+    size_t filled = 0;
+    bool   eof    = false;
+
+    while(valid && (eof == false || filled > 0)) {
+        if(eof == false) {
+            size_t n = fread(buffer + filled, 1, OBJ_CHUNK_SIZE - filled, f);
+            eof      = (n == 0);
+            filled  += n;
+        }
+
+        char* line = buffer;
+        char* end  = buffer + filled;
+
+        // Parse every complete line, and the trailing one once the file is done
+        while(valid && line < end) {
+            char* newline = memchr(line, '\n', end - line);
+
+            if(newline == NULL) {
+                if(eof == false) {
+                    break;
+                }
+                newline = end;
+            }
+
+            *newline = '\0';
+            s.line++;
+
+            if(obj_parse_line(&s, line) == false) {
+                debug_printf(DEBUG_ERROR, "Malformed or unsupported line %d in model: %s\n", s.line, asset);
+                valid = false;
+            }
+
+            line = newline + 1;
+        }
+
+        filled = (line < end) ? (size_t)(end - line) : 0;
+        memmove(buffer, line, filled);
+
+        if(filled == OBJ_CHUNK_SIZE) {
+            debug_printf(DEBUG_ERROR, "Line %d is too long in model: %s\n", s.line + 1, asset);
+            valid = false;
+        }
+    }
+
+    mem_free(MEM_TAG_SCRATCH, buffer);
+    fclose(f);
 
-#include <ctype.h>
-#include <string.h>
+    // Resolve corners into unique vertices now that every attribute is known
+    const obj_corner_t* corners        = (const obj_corner_t*)s.corners.data;
+    vec3_t*             smooth_normals = NULL;
+    vertex_table_t      table          = {0};
+    mesh_t              m              = {0};
 
-#include "light.h" // TODO: Fix this hardcoded reest
+    if(valid) {
+        for(size_t i = 0; i < s.corners.count; i++) {
+            if(corners[i].v  < 1 || (size_t)corners[i].v  > s.positions.count ||
+               corners[i].vt < 0 || (size_t)corners[i].vt > s.uvs.count ||
+               corners[i].vn < 0 || (size_t)corners[i].vn > s.normals.count) {
+                debug_printf(DEBUG_ERROR, "Face index out of range in model: %s\n", asset);
+                valid = false;
+                break;
+            }
+        }
+    }
 
+    for(size_t i = 0; valid && i < s.corners.count; i++) {
+        if(corners[i].vn == 0) {
+            if((smooth_normals = obj_smooth_normals(&s)) == NULL) {
+                debug_printf(DEBUG_ERROR, "Failed to allocate memory for model normals.\n");
+                valid = false;
+            }
+            break;
+        }
+    }
 
-static model_t model[CONFIG_MAX_MODELS];
-static bool    model_occupied[CONFIG_MAX_MODELS];
-static size_t  model_count;
-static size_t  model_memory;
+    if(valid) {
+        m.vertices = mem_malloc(MEM_TAG_SCRATCH, sizeof(gfx_vertex_t) * (s.corners.count + 1));
+        m.normals  = mem_malloc(MEM_TAG_SCRATCH, sizeof(vec3_t) * (s.corners.count + 1));
+        m.indices  = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * (s.corners.count + 1));
 
-void model_initialize(void)
-{
-    for(int i = 0; i < CONFIG_MAX_MODELS; i++) {
-        model_t m = {0};
-        model[i] = m;
-        model_occupied[i] = false;
+        if(m.vertices == NULL || m.normals == NULL || m.indices == NULL ||
+           vertex_table_create(&table, s.corners.count) == false) {
+            debug_printf(DEBUG_ERROR, "Failed to allocate memory for model vertices.\n");
+            valid = false;
+        }
     }
 
-    model_count  = 0;
-    model_memory = 0;
+    for(size_t i = 0; valid && i < s.corners.count; i++) {
+        vertex_key_t key   = { corners[i].v, corners[i].vt, corners[i].vn };
+        size_t       index = vertex_table_insert(&table, key);
 
-    debug_printf(DEBUG_INFO, "Initialized model manager.\n");
-    debug_printf(DEBUG_BLANK,"Model limit: %d\n", CONFIG_MAX_MODELS);
+        if(index >= MODEL_MAX_VERTICES) {
+            debug_printf(DEBUG_ERROR, "Model has more than %d unique vertices.\n", MODEL_MAX_VERTICES);
+            valid = false;
+            break;
+        }
+
+        if(index == m.vertex_count) { // First use of this triple
+            const float* uv = (const float*)s.uvs.data;
+            gfx_vertex_t* v = &m.vertices[index];
+            v->color.argb = 0x00000000;
+            v->position   = ((const vec3_t*)s.positions.data)[key.v - 1];
+            v->u          = key.vt ? uv[(2*(key.vt-1))+0] : 0.0f;
+            v->v          = key.vt ? uv[(2*(key.vt-1))+1] : 0.0f;
+            m.normals[index] = key.vn ? ((const vec3_t*)s.normals.data)[key.vn - 1]
+                                      : smooth_normals[key.v - 1];
+            m.vertex_count++;
+        }
+
+        m.indices[m.index_count++] = (uint16_t)index;
+    }
+
+    model_mid_t mid = MODEL_ERROR;
+
+    if(valid) {
+        debug_printf(DEBUG_INFO, "Parsed OBJ model: %s\n", asset);
+        debug_printf(DEBUG_BLANK,"Vertices: %d   UVs: %d   Normals: %d   Faces: %d\n", s.positions.count, s.uvs.count, s.normals.count, s.face_count);
+
+        mid = model_create(asset, &m, tid, textured);
+    }
+
+    if(table.slots != NULL) {
+        vertex_table_destroy(&table);
+    }
+
+    mem_free(MEM_TAG_SCRATCH, smooth_normals);
+    mem_free(MEM_TAG_SCRATCH, m.vertices);
+    mem_free(MEM_TAG_SCRATCH, m.normals);
+    mem_free(MEM_TAG_SCRATCH, m.indices);
+    obj_state_free(&s);
+
+    return mid;
 }
 
+// ============================================================================
+// Binary Models - Baked from OBJ on the host by util/obj_to_mdl.py
+// ============================================================================
+// The whole file is read with a single fread and needs no parsing. Fields are
+// little endian and every blob starts on a 32-byte boundary. Deduplication,
+// bounds, clusters, strips and triangle planes are all done by the baker, in
+// the same way model_create does them, so the blobs are copied in as they are.
+
+#define MODEL_BIN_MAGIC   (0x4C444D45) // "EMDL"
+#define MODEL_BIN_VERSION (2)
 
-// TODO: tidy up this function
-model_mid_t model_load_obj(const char* asset, gfx_tid_t tid, bool textured)
+typedef struct model_bin_header_t
+{
+    uint32_t       magic;
+    uint32_t       version;
+    uint32_t       vertex_count;
+    uint32_t       triangle_count;
+    uint32_t       strip_index_count;
+    uint32_t       strip_count;
+    uint32_t       cluster_count;
+    uint32_t       flags;          // MODEL_BIN_FLAG_*
+    uint32_t       vertex_offset;  // gfx_vertex_t[vertex_count], in cluster order
+    uint32_t       normal_offset;  // vec3_t[vertex_count]
+    uint32_t       strip_offset;   // uint16_t[strip_index_count]
+    uint32_t       length_offset;  // uint16_t[strip_count]
+    uint32_t       plane_offset;   // mv_plane_t[strip_index_count - 2 * strip_count]
+    uint32_t       cluster_offset; // model_cluster_t[cluster_count]
+    model_bounds_t bounds;
+} model_bin_header_t;
+
+#define MODEL_BIN_FLAG_PRELIT (1 << 0) // Vertex colors hold baked lighting, see util/bake_light.py
+
+static bool bin_blob_valid(uint32_t offset, size_t size, size_t file_size)
+{
+    return (offset % 32) == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+// Clusters have to follow each other through the strips and the vertices, and
+// strips may only use the vertices of their own cluster
+static bool bin_clusters_valid(const model_bin_header_t* h, const uint16_t* strips, const uint16_t* lengths,
+                               const model_cluster_t* clusters)
+{
+    size_t first_index  = 0;
+    size_t first_strip  = 0;
+    size_t first_vertex = 0;
+
+    for(size_t i = 0; i < h->cluster_count; i++) {
+        const model_cluster_t* c = &clusters[i];
+
+        if(c->first_index != first_index || c->first_strip != first_strip || c->first_vertex != first_vertex ||
+           c->strip_count > h->strip_count - first_strip || c->vertex_count > h->vertex_count - first_vertex) {
+            return false;
+        }
+
+        for(size_t j = first_strip; j < first_strip + c->strip_count; j++) {
+            if(lengths[j] < 3 || lengths[j] > h->strip_index_count - first_index) {
+                return false;
+            }
+
+            for(size_t k = first_index; k < first_index + lengths[j]; k++) {
+                if(strips[k] < first_vertex || strips[k] >= first_vertex + c->vertex_count) {
+                    return false;
+                }
+            }
+
+            first_index += lengths[j];
+        }
+
+        first_strip  += c->strip_count;
+        first_vertex += c->vertex_count;
+    }
+
+    return first_index == h->strip_index_count && first_strip == h->strip_count && first_vertex == h->vertex_count;
+}
+
+model_mid_t model_load_bin(const char* asset, gfx_tid_t tid, bool textured)
 {
     if(model_count >= CONFIG_MAX_MODELS) {
         debug_printf(DEBUG_ERROR, "Cannot allocate more than %d models.\n", CONFIG_MAX_MODELS);
         return MODEL_ERROR;
     }
 
-    model_t m;
-    m.faces      = NULL;
-    m.face_count = 0;
-    m.tid        = textured ? tid : GFX_UNUSED;
-    m.textured   = textured;
-    m.mid        = 0;
-
     FILE* f = NULL;
-    
-    size_t vertex_count = 0;
-    size_t uv_count     = 0;
-    size_t normal_count = 0;
-    size_t face_count   = 0;
-    
-    float* vertices = NULL;
-    float* uv       = NULL;
-    float* normals  = NULL;
-
-    char line[256] = {0}; // 255 characters for a line should be enough.
-
-    if((f = fopen(asset, "r")) == NULL) {
+    long  size;
+    void* blob;
+
+    if((f = fopen(asset, "rb")) == NULL) {
         debug_printf(DEBUG_ERROR, "Couldn't open specified model: %s\n", asset);
         return MODEL_ERROR;
     }
 
-    // Initially parse for amount of vertices, UVs and faces
-    while(fgets(line, sizeof(line), f)) {
-        if(line[0] == 'v' && isspace((int)line[1])) {
-            vertex_count++;
-        }
-        else if(line[0] == 'v' && line[1] == 't') {
-            uv_count++;
-        }
-        else if(line[0] == 'v' && line[1] == 'n') {
-            normal_count++;
-        }
-        else if(line[0] == 'f') {
-            face_count++;
-        }
-    }
-    
-    if((vertices = malloc(sizeof(float) * vertex_count * 3)) == NULL) {
-        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model vertices.\n");
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+
+    if(size < (long)sizeof(model_bin_header_t)) {
+        debug_printf(DEBUG_ERROR, "Model file is too small: %s\n", asset);
         fclose(f);
         return MODEL_ERROR;
     }
-    if((uv = malloc(sizeof(float) * uv_count * 2)) == NULL) {
-        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model UVs.\n");
+
+    if((blob = mem_memalign(MEM_TAG_SCRATCH, 32, size)) == NULL) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model file.\n");
         fclose(f);
-        free(vertices);
         return MODEL_ERROR;
     }
-    if((normals = malloc(sizeof(float) * normal_count * 3)) == NULL) {
-        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model normals.\n");
+
+    if(fread(blob, 1, size, f) != (size_t)size) {
+        debug_printf(DEBUG_ERROR, "Failed to read model from: %s\n", asset);
         fclose(f);
-        free(vertices);
-        free(uv);
+        mem_free(MEM_TAG_SCRATCH, blob);
         return MODEL_ERROR;
     }
-    if((m.faces = malloc(sizeof(model_face_t) * face_count)) == NULL) {
-        debug_printf(DEBUG_ERROR, "Failed to allocate memory for model faces.\n");
-        fclose(f);
-        free(vertices);
-        free(uv);
-        free(normals);
+
+    fclose(f);
+
+    const model_bin_header_t* h    = (const model_bin_header_t*)blob;
+    const uint8_t*            base = (const uint8_t*)blob;
+
+    if(h->magic != MODEL_BIN_MAGIC || h->version != MODEL_BIN_VERSION) {
+        debug_printf(DEBUG_ERROR, "Not a version %d binary model: %s\n", MODEL_BIN_VERSION, asset);
+        mem_free(MEM_TAG_SCRATCH, blob);
         return MODEL_ERROR;
     }
 
-    rewind(f);
+    if(h->vertex_count > MODEL_MAX_VERTICES || h->strip_index_count < 3 * (size_t)h->strip_count ||
+       bin_blob_valid(h->vertex_offset,  sizeof(gfx_vertex_t) * h->vertex_count, size) == false ||
+       bin_blob_valid(h->normal_offset,  sizeof(vec3_t) * h->vertex_count, size) == false ||
+       bin_blob_valid(h->strip_offset,   sizeof(uint16_t) * h->strip_index_count, size) == false ||
+       bin_blob_valid(h->length_offset,  sizeof(uint16_t) * h->strip_count, size) == false ||
+       bin_blob_valid(h->plane_offset,   sizeof(mv_plane_t) * (h->strip_index_count - 2 * h->strip_count), size) == false ||
+       bin_blob_valid(h->cluster_offset, sizeof(model_cluster_t) * h->cluster_count, size) == false ||
+       bin_clusters_valid(h, (const uint16_t*)(base + h->strip_offset), (const uint16_t*)(base + h->length_offset),
+                          (const model_cluster_t*)(base + h->cluster_offset)) == false) {
+        debug_printf(DEBUG_ERROR, "Corrupt binary model: %s\n", asset);
+        mem_free(MEM_TAG_SCRATCH, blob);
+        return MODEL_ERROR;
+    }
+
+    mesh_t mesh;
+    mesh.vertices     = (gfx_vertex_t*)(base + h->vertex_offset);
+    mesh.normals      = (vec3_t*)(base + h->normal_offset);
+    mesh.indices      = NULL;
+    mesh.vertex_count = h->vertex_count;
+    mesh.index_count  = 0;
+    mesh.prelit       = (h->flags & MODEL_BIN_FLAG_PRELIT) != 0;
+
+    bool    lit    = (textured == false || tid == GFX_UNUSED);
+    bool    prelit = lit && mesh.prelit;
+    model_t m      = {0};
+
+    if(model_allocate(&m, h->vertex_count, h->strip_index_count, h->strip_count, h->cluster_count, lit, prelit) == false) {
+        mem_free(MEM_TAG_SCRATCH, blob);
+        return MODEL_ERROR;
+    }
+
+    m.bounds         = h->bounds;
+    m.triangle_count = h->triangle_count;
+    m.tid            = textured ? tid : GFX_UNUSED;
+    m.textured       = textured;
+
+    store_vertices(&m, &mesh, NULL);
+
+    if(prelit == true) {
+        for(size_t i = 0; i < m.vertex_count; i++) {
+            m.colors[i] = mesh.vertices[i].color;
+        }
+    }
+
+    memcpy(m.strips,        base + h->strip_offset,   sizeof(uint16_t) * m.strip_index_count);
+    memcpy(m.strip_lengths, base + h->length_offset,  sizeof(uint16_t) * m.strip_count);
+    memcpy(m.planes,        base + h->plane_offset,   sizeof(mv_plane_t) * (m.strip_index_count - 2 * m.strip_count));
+    memcpy(m.clusters,      base + h->cluster_offset, sizeof(model_cluster_t) * m.cluster_count);
+
+    mem_free(MEM_TAG_SCRATCH, blob);
+
+    return model_register(asset, &m);
+}
+
+// ============================================================================
+// Level of Detail Groups - One handle for several meshes of the same model
+// ============================================================================
+
+model_mid_t model_create_lod(const model_mid_t* levels, const float* thresholds, size_t count)
+{
+    if(count == 0 || count > MODEL_MAX_LODS) {
+        debug_printf(DEBUG_ERROR, "LOD groups need between 1 and %d levels.\n", MODEL_MAX_LODS);
+        return MODEL_ERROR;
+    }
 
-    size_t vertex_idx = 0;
-    size_t uv_idx     = 0;
-    size_t normal_idx = 0;
-    
+    if(model_count >= CONFIG_MAX_MODELS) {
+        debug_printf(DEBUG_ERROR, "Cannot allocate more than %d models.\n", CONFIG_MAX_MODELS);
+        return MODEL_ERROR;
+    }
 
-    // Since vertices can be defined after faces, collect all vertex info first
-    while(fgets(line, sizeof(line), f)) {
-        if(line[0] == 'v' && isspace((int)line[1])) {
-            float x, y, z;
-            sscanf(line, "v %f %f %f", &x, &y, &z);
-            vertices[vertex_idx++] = x;
-            vertices[vertex_idx++] = y;
-            vertices[vertex_idx++] = z;
+    for(size_t i = 0; i < count; i++) {
+        if(levels[i] >= CONFIG_MAX_MODELS || model_occupied[levels[i]] == false ||
+           model[levels[i]].lod.level_count > 0) {
+            debug_printf(DEBUG_ERROR, "Received invalid model ID (%d) for LOD level %d.\n", levels[i], i);
+            return MODEL_ERROR;
         }
-        else if(line[0] == 'v' && line[1] == 't') {
-            float u, v;
-            sscanf(line, "vt %f %f", &u, &v);
-            uv[uv_idx++] = u;
-            uv[uv_idx++] = v;
+
+        for(size_t j = 0; j < i; j++) {
+            if(levels[j] == levels[i]) {
+                debug_printf(DEBUG_ERROR, "Model ID (%d) is used for more than one LOD level.\n", levels[i]);
+                return MODEL_ERROR;
+            }
         }
-        else if(line[0] == 'v' && line[1] == 'n') {
-            float x, y, z;
-            sscanf(line, "vn %f %f %f", &x, &y, &z);
-            normals[normal_idx++] = x;
-            normals[normal_idx++] = y;
-            normals[normal_idx++] = z;
+    }
+
+    for(size_t i = 0; i + 1 < count; i++) {
+        if(thresholds[i] <= 0.0f || (i > 0 && thresholds[i] >= thresholds[i - 1])) {
+            debug_printf(DEBUG_ERROR, "LOD thresholds must be positive and decreasing.\n");
+            return MODEL_ERROR;
         }
     }
 
-    rewind(f);
+    model_t m = {0};
 
-    size_t face_idx   = 0;
-
-    while(fgets(line, sizeof(line), f)) {
-        if(line[0] == 'f') {
-            size_t va, vta, vna;
-            size_t vb, vtb, vnb;
-            size_t vc, vtc, vnc;
-            sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",  &va, &vta, &vna,
-                                                          &vb, &vtb, &vnb,
-                                                          &vc, &vtc, &vnc);
-
-            m.faces[face_idx].a.color.argb = 0x00000000;
-            m.faces[face_idx].a.position.x = vertices[(3*(va-1))+0];
-            m.faces[face_idx].a.position.y = vertices[(3*(va-1))+1];
-            m.faces[face_idx].a.position.z = vertices[(3*(va-1))+2];
-            m.faces[face_idx].a.u = uv[(2*(vta-1))+0];
-            m.faces[face_idx].a.v = uv[(2*(vta-1))+1];
-            m.faces[face_idx].an.x = normals[(3*(vna-1))+0];
-            m.faces[face_idx].an.y = normals[(3*(vna-1))+1];
-            m.faces[face_idx].an.z = normals[(3*(vna-1))+2];
-
-            m.faces[face_idx].b.color.argb = 0x00000000;
-            m.faces[face_idx].b.position.x = vertices[(3*(vb-1))+0];
-            m.faces[face_idx].b.position.y = vertices[(3*(vb-1))+1];
-            m.faces[face_idx].b.position.z = vertices[(3*(vb-1))+2];
-            m.faces[face_idx].b.u = uv[(2*(vtb-1))+0];
-            m.faces[face_idx].b.v = uv[(2*(vtb-1))+1];
-            m.faces[face_idx].bn.x = normals[(3*(vnb-1))+0];
-            m.faces[face_idx].bn.y = normals[(3*(vnb-1))+1];
-            m.faces[face_idx].bn.z = normals[(3*(vnb-1))+2];
-
-            m.faces[face_idx].c.color.argb = 0x00000000;
-            m.faces[face_idx].c.position.x = vertices[(3*(vc-1))+0];
-            m.faces[face_idx].c.position.y = vertices[(3*(vc-1))+1];
-            m.faces[face_idx].c.position.z = vertices[(3*(vc-1))+2];
-            m.faces[face_idx].c.u = uv[(2*(vtc-1))+0];
-            m.faces[face_idx].c.v = uv[(2*(vtc-1))+1];
-            m.faces[face_idx].cn.x = normals[(3*(vnc-1))+0];
-            m.faces[face_idx].cn.y = normals[(3*(vnc-1))+1];
-            m.faces[face_idx].cn.z = normals[(3*(vnc-1))+2];
-            
-
-            face_idx++;
-        }
-    }
-
-    free(vertices);
-    free(uv);
-    free(normals);
-    fclose(f);
+    for(size_t i = 0; i < count; i++) {
+        m.lod.levels[i] = levels[i];
+        if(i + 1 < count) {
+            m.lod.thresholds[i] = thresholds[i];
+        }
+    }
 
-    model_mid_t first_available = 0;
+    m.lod.level_count = count;
+    m.bounds          = model[levels[0]].bounds;
 
-    while(model_occupied[first_available] == true) {
-        first_available++;
-    }
+    model_mid_t mid = 0;
 
-    model_mid_t mid = first_available;
+    while(model_occupied[mid] == true) {
+        mid++;
+    }
 
     model_occupied[mid] = true;
-
     model_count++;
-    model_memory += sizeof(model_face_t) * face_count;
-
-    m.mid = mid;
-    m.face_count = face_count;
 
+    m.mid      = mid;
     model[mid] = m;
 
-    debug_printf(DEBUG_INFO, "Loaded model (mid = %d)\n", mid);
-    debug_printf(DEBUG_BLANK,"Asset: %s\n", asset);
-    debug_printf(DEBUG_BLANK,"Vertices: %d   UVs: %d   Normals: %d   Faces: %d\n", vertex_count, uv_count, normal_count, face_count);
-
-    debug_printf(DEBUG_INFO, "Active models: %d\n", model_count);
-    debug_printf(DEBUG_BLANK, "Model memory used: %.1f KiB\n", model_memory / 1024.0f);
+    debug_printf(DEBUG_INFO, "Created LOD group (mid = %d)\n", mid);
+    debug_printf(DEBUG_BLANK,"Levels: %d\n", count);
 
     return mid;
 }
 
+// Level for a projected radius, without hysteresis
+static model_mid_t lod_level(const model_lod_t* l, float radius)
+{
+    size_t level = 0;
+
+    while(level + 1 < l->level_count && radius < l->thresholds[level]) {
+        level++;
+    }
+
+    return l->levels[level];
+}
+
+// Picks the level for the current transform. A level only changes once the
+// projected radius is past the threshold by the hysteresis margin, so models
+// sitting right on a threshold don't flicker between two levels.
+static model_mid_t lod_select(model_t* m)
+{
+    model_lod_t* l = &m->lod;
+    float        r = mv_projected_radius(m->bounds.center, m->bounds.radius);
+
+    while(l->current > 0 && r > l->thresholds[l->current - 1] * (1.0f + CONFIG_MODEL_LOD_HYSTERESIS)) {
+        l->current--;
+    }
+
+    while(l->current + 1 < l->level_count && r < l->thresholds[l->current] * (1.0f - CONFIG_MODEL_LOD_HYSTERESIS)) {
+        l->current++;
+    }
+
+    return l->levels[l->current];
+}
+
 void model_free_obj(model_mid_t mid)
 {
     if(mid >= CONFIG_MAX_MODELS || model_occupied[mid] == false) {
@@ -233,49 +1330,322 @@ void model_free_obj(model_mid_t mid)
         return;
     }
 
-    free(model[mid].faces);
+    // A LOD group owns its levels
+    for(size_t i = 0; i < model[mid].lod.level_count; i++) {
+        model_free_obj(model[mid].lod.levels[i]);
+    }
+
+    mem_free(MEM_TAG_MODEL, model[mid].data);
 
     model_count--;
-    model_memory -= sizeof(model_face_t) * model[mid].face_count;
     model_occupied[mid] = false;
 
     debug_printf(DEBUG_INFO, "Freed model (mid = %d)\n", mid);
     debug_printf(DEBUG_INFO, "Active models: %d\n", model_count);
-    debug_printf(DEBUG_BLANK,"Model memory used: %.1f KiB\n", model_memory/1024.0f);
+    debug_printf(DEBUG_BLANK,"Model memory used: %.1f KiB\n", mem_get_usage(MEM_TAG_MODEL, MEM_POOL_RAM).current/1024.0f);
+}
+
+const model_t* model_get(model_mid_t mid)
+{
+    if(mid >= CONFIG_MAX_MODELS || model_occupied[mid] == false) {
+        return NULL;
+    }
+
+    return &model[mid];
+}
+
+// Collects the runs of front facing triangles of a cluster into scratch_runs
+// and the vertices they use into scratch_used. A run always starts on an
+// even triangle so its winding stays intact, if need be by including the
+// backfacing triangle before it, which the PVR then culls.
+static void collect_runs(const model_t* m, const model_cluster_t* c, size_t* run_count, size_t* used_count)
+{
+    const uint16_t*   strip  = &m->strips[c->first_index];
+    const uint16_t*   length = &m->strip_lengths[c->first_strip];
+    const mv_plane_t* plane  = &m->planes[c->first_index - 2 * c->first_strip];
+
+    size_t runs = 0;
+    size_t used = 0;
+
+    if(++scratch_draw == 0) {
+        memset(scratch_stamp, 0, sizeof(uint32_t) * scratch_vertices);
+        scratch_draw = 1;
+    }
+
+    for(size_t i = 0; i < c->strip_count; i++) {
+        size_t triangles = length[i] - 2;
+        size_t start     = 0;
+        bool   open      = false;
+
+        for(size_t j = 0; j <= triangles; j++) {
+            bool front = (j < triangles) && mv_plane_test_frontfacing(plane++);
+
+            if(front == true && open == false) {
+                start = j & ~(size_t)1;
+                open  = true;
+            } else if(front == false && open == true) {
+                scratch_runs[runs].indices = &strip[start];
+                scratch_runs[runs].count   = j + 2 - start;
+                runs++;
+                open = false;
+
+                for(size_t k = start; k < j + 2; k++) {
+                    if(scratch_stamp[strip[k]] != scratch_draw) {
+                        scratch_stamp[strip[k]] = scratch_draw;
+                        scratch_used[used++]    = strip[k];
+                    }
+                }
+            }
+        }
+
+        strip += length[i];
+    }
+
+    *run_count  = runs;
+    *used_count = used;
+}
+
+#define MODEL_LIGHT_BATCH (64)
+
+// Drops the cached colors if the lights or the transform changed since they
+// were calculated. The version of the transform changes whenever another
+// model is drawn in between, so the transform itself is compared as well.
+// Colors are also kept while light_prepare keeps giving the same lights, like
+// for instances that are all lit the same way. Call after light_prepare.
+static void validate_colors(model_t* m)
+{
+    uint32_t light_version    = light_get_version();
+    uint32_t object_version   = mv_get_object_version();
+    uint32_t prepared_version = light_get_prepared_version();
+
+    bool valid = (m->lit_prepared_version == prepared_version) ||
+                 (m->lit_light_version == light_version &&
+                  (m->lit_object_version == object_version ||
+                   memcmp(&m->lit_object_to_eye, mv_get_object_to_eye(), sizeof(mat4_t)) == 0));
+
+    m->lit_light_version    = light_version;
+    m->lit_prepared_version = prepared_version;
+
+    if(m->lit_object_version != object_version) {
+        m->lit_object_version = object_version;
+        m->lit_object_to_eye  = *mv_get_object_to_eye();
+    }
+
+    if(valid == true) {
+        return;
+    }
+
+    if(++m->color_generation == 0) {
+        memset(m->color_stamps, 0, sizeof(uint32_t) * m->vertex_count);
+        m->color_generation = 1;
+    }
+}
+
+// Colors vertices[indices[0..count-1]] from the cache where it is valid and
+// lights the rest in batches, gathering their object space positions and
+// normals for light_calculate_batch
+static void light_vertices(model_t* m, const uint16_t* indices, size_t count, gfx_vertex_t* v)
+{
+    static vec3_t      positions[MODEL_LIGHT_BATCH];
+    static vec3_t      normals[MODEL_LIGHT_BATCH];
+    static gfx_color_t colors[MODEL_LIGHT_BATCH];
+    static uint16_t    pending[MODEL_LIGHT_BATCH];
+
+    size_t n = 0;
+
+    for(size_t i = 0; i <= count; i++) {
+        if(n == MODEL_LIGHT_BATCH || (i == count && n > 0)) {
+            light_calculate_batch(positions, normals, colors, n);
+
+            for(size_t j = 0; j < n; j++) {
+                uint16_t k = pending[j];
+                m->colors[k]       = colors[j];
+                m->color_stamps[k] = m->color_generation;
+                v[k].color         = colors[j];
+            }
+
+            n = 0;
+        }
+
+        if(i == count) {
+            break;
+        }
+
+        uint16_t k = indices[i];
+
+        if(m->color_stamps[k] == m->color_generation) {
+            v[k].color = m->colors[k];
+            continue;
+        }
+
+        pending[n]   = k;
+        positions[n] = model_vertex_position(m, k);
+        normals[n]   = model_vertex_normal(m, k);
+        n++;
+    }
+}
+
+// Transforms, lights and draws the front facing part of a single cluster.
+// Vertices are transformed into the same positions of the scratch buffer, so
+// the strips index it directly.
+static void render_cluster(model_t* m, const model_cluster_t* c)
+{
+    gfx_vertex_t* v = scratch;
+    size_t        run_count;
+    size_t        used_count;
+
+    collect_runs(m, c, &run_count, &used_count);
+
+    if(run_count == 0) {
+        return;
+    }
+
+    // Every vertex in use is transformed and lit exactly once
+    PROF_SCOPE(PROF_TRANSFORM) {
+        model_transform_vertices(m, scratch_used, used_count, v);
+    }
+
+    if(m->textured == true && m->tid != GFX_UNUSED) {
+        PROF_SCOPE(PROF_LIGHTING) {
+            for(size_t i = 0; i < used_count; i++) {
+                model_vertex_attributes(m, scratch_used[i], &v[scratch_used[i]]);
+            }
+        }
+
+        PROF_SCOPE(PROF_SUBMIT) {
+            for(size_t i = 0; i < run_count; i++) {
+                gfx_draw_op_tex_strip(v, scratch_runs[i].indices, scratch_runs[i].count, m->tid);
+            }
+        }
+
+        return;
+    }
+
+    PROF_SCOPE(PROF_LIGHTING) {
+        if(m->prelit == true) {
+            for(size_t i = 0; i < used_count; i++) {
+                v[scratch_used[i]].color = m->colors[scratch_used[i]];
+            }
+        } else {
+            light_vertices(m, scratch_used, used_count, v);
+        }
+    }
+
+    PROF_SCOPE(PROF_SUBMIT) {
+        for(size_t i = 0; i < run_count; i++) {
+            gfx_draw_op_strip(v, scratch_runs[i].indices, scratch_runs[i].count);
+        }
+    }
+}
+
+// Whole model against the frustum, the box is only tested when the sphere is
+// inconclusive
+static mv_cull_t cull_mesh(const model_t* m)
+{
+    mv_cull_t cull = mv_frustum_test_sphere(m->bounds.center, m->bounds.radius);
+
+    if(cull == MV_CULL_INTERSECT) {
+        cull = mv_frustum_test_box(m->bounds.min, m->bounds.max);
+    }
+
+    return cull;
+}
+
+// Draws a single mesh with the current transform, testing its clusters
+// against the frustum if the mesh isn't known to be inside
+static void draw_mesh(model_t* m, mv_cull_t cull)
+{
+    if(scratch_reserve(m->vertex_count, m->triangle_count) == false) {
+        return;
+    }
+
+    // Lighting happens in model space, so the lights move instead of the normals
+    if(m->color_stamps != NULL) {
+        PROF_SCOPE(PROF_LIGHTING) {
+            light_prepare(m->bounds.center, m->bounds.radius);
+            validate_colors(m);
+        }
+    }
+
+    for(size_t i = 0; i < m->cluster_count; i++) {
+        const model_cluster_t* c = &m->clusters[i];
+
+        if(cull == MV_CULL_INTERSECT && mv_frustum_test_sphere(c->center, c->radius) == MV_CULL_OUTSIDE) {
+            continue;
+        }
+
+        render_cluster(m, c);
+    }
+}
+
+// Culls and draws a single mesh with the current transform
+static void render_mesh(model_t* m)
+{
+    if(m->strip_count == 0) {
+        return;
+    }
+
+    mv_cull_t cull = cull_mesh(m);
+
+    if(cull != MV_CULL_OUTSIDE) {
+        draw_mesh(m, cull);
+    }
 }
 
 void model_render_obj(model_mid_t mid)
 {
-    model_t m = model[mid];
-
-    if(m.textured == true && m.tid != GFX_UNUSED) {
-        for(size_t i = 0; i < m.face_count; i++) {
-            gfx_vertex_t a = m.faces[i].a;
-            gfx_vertex_t b = m.faces[i].b;
-            gfx_vertex_t c = m.faces[i].c;
-            a.position = mv_mat_vec_transform(a.position);
-            b.position = mv_mat_vec_transform(b.position);
-            c.position = mv_mat_vec_transform(c.position);
-            
-            gfx_draw_op_tex_tri(a, b, c, m.tid);
-        }
-    }
-    else {
-        for(size_t i = 0; i < m.face_count; i++) {
-            gfx_vertex_t a = m.faces[i].a;
-            gfx_vertex_t b = m.faces[i].b;
-            gfx_vertex_t c = m.faces[i].c;
-            a.position = mv_mat_vec_transform(a.position);
-            b.position = mv_mat_vec_transform(b.position);
-            c.position = mv_mat_vec_transform(c.position);
-            gfx_color_t colora = light_calculate_color(a.position, m.faces[i].an); // TODO: Remove this hardcoded reest
-            a.color = colora;
-            gfx_color_t colorb = light_calculate_color(b.position, m.faces[i].bn); // TODO: Remove this hardcoded reest
-            b.color = colorb;
-            gfx_color_t colorc = light_calculate_color(c.position, m.faces[i].cn); // TODO: Remove this hardcoded reest
-            c.color = colorc;
-            
-            gfx_draw_op_tri(a, b, c);
-        }
-    }
-}
\ No newline at end of file
+    model_t* m = &model[mid];
+
+    if(m->lod.level_count > 0) {
+        m = &model[lod_select(m)];
+    }
+
+    render_mesh(m);
+}
+
+// Draws the model once for every transform, each applied on top of the
+// modelview as of the last mv_calculate_transform. Instances are culled in
+// the view's space before anything is calculated for them, and only those
+// crossing the frustum get planes of their own. LOD groups pick a level per
+// instance, without hysteresis since instances keep no state. The plain
+// transform is restored afterwards.
+void model_render_instances(model_mid_t mid, const mat4_t* transforms, size_t count)
+{
+    if(mid >= CONFIG_MAX_MODELS || model_occupied[mid] == false) {
+        debug_printf(DEBUG_ERROR, "Received invalid model ID (%d) for rendering.\n", mid);
+        return;
+    }
+
+    model_t* m = &model[mid];
+
+    for(size_t i = 0; i < count; i++) {
+        mv_cull_t cull = mv_frustum_test_instance(&transforms[i], m->bounds.center, m->bounds.radius);
+
+        if(cull == MV_CULL_OUTSIDE) {
+            continue;
+        }
+
+        mv_calculate_transform_instance(&transforms[i], cull == MV_CULL_INTERSECT);
+
+        model_t* level = m;
+
+        if(m->lod.level_count > 0) {
+            level = &model[lod_level(&m->lod, mv_projected_radius(m->bounds.center, m->bounds.radius))];
+        }
+
+        if(level->strip_count == 0) {
+            continue;
+        }
+
+        // The level's own bounds, now that there are planes to test them against
+        if(cull == MV_CULL_INTERSECT) {
+            cull = cull_mesh(level);
+        }
+
+        if(cull != MV_CULL_OUTSIDE) {
+            draw_mesh(level, cull);
+        }
+    }
+
+    mv_calculate_transform_instance(NULL, false);
+}
@@ -17,26 +17,98 @@ typedef uint8_t model_mid_t;
 #define MODEL_ERROR (255)
 #define MODEL_FREED (254)
 
-typedef struct model_face_t
+#define MODEL_MAX_VERTICES (65535) // Indices are 16-bit
+#define MODEL_MAX_LODS     (4)
+
+typedef struct model_bounds_t
+{
+    vec3_t min, max; // Axis-aligned box
+    vec3_t center;   // Bounding sphere
+    float  radius;
+} model_bounds_t;
+
+// Part of a model that is culled on its own. Clusters own a contiguous run of
+// vertices and strips, so a culled cluster costs no vertex work at all.
+typedef struct model_cluster_t
+{
+    vec3_t   center;       // Bounding sphere
+    float    radius;
+    uint32_t first_index;  // Into model_t.strips
+    uint32_t first_strip;  // Into model_t.strip_lengths
+    uint32_t strip_count;
+    uint16_t first_vertex;
+    uint16_t vertex_count;
+} model_cluster_t;
+
+#ifdef CONFIG_MODEL_QUANTIZED
+// 12 bytes, against 36 for a gfx_vertex_t plus a float normal
+typedef struct model_qvertex_t
 {
-    gfx_vertex_t a, b, c;
-    vec3_t       an, bn, cn;
-} model_face_t;
+    int16_t  x, y, z; // Position, q * model_t.scale + model_t.offset
+    uint16_t normal;  // Octahedral, 8 bits per axis
+    int16_t  u, v;    // Texture coordinates, q * model_t.uv_scale + model_t.uv_offset
+} model_qvertex_t;
+#endif
+
+// A model handle that owns several meshes of decreasing detail. Level i + 1
+// is drawn once the projected bounding sphere radius drops below
+// thresholds[i] pixels.
+typedef struct model_lod_t
+{
+    model_mid_t levels[MODEL_MAX_LODS];   // Most detailed first
+    float   thresholds[MODEL_MAX_LODS - 1];
+    size_t  level_count;                  // 0 for a plain mesh
+    size_t  current;                      // Level drawn last, for hysteresis
+} model_lod_t;
 
 typedef struct model_t
 {
-    model_face_t* faces;
-    size_t        face_count;
-    gfx_tid_t     tid;
-    bool          textured;
-    model_mid_t   mid;
+    void*          data;          // Single allocation holding all the arrays below
+    size_t         data_size;
+#ifdef CONFIG_MODEL_QUANTIZED
+    model_qvertex_t* vertices;    // Unique position/UV/normal triples
+    vec3_t         scale, offset; // Dequantization of positions
+    float          uv_scale[2];   // and of texture coordinates, u then v
+    float          uv_offset[2];
+#else
+    gfx_vertex_t*  vertices;      // Unique position/UV pairs
+    vec3_t*        normals;       // One per vertex
+#endif
+    uint16_t*      strips;        // Triangle strips back to back, indexing vertices
+    uint16_t*      strip_lengths;
+    mv_plane_t*    planes;        // One per strip triangle, in strip order
+    model_cluster_t* clusters;
+    size_t         cluster_count;
+    gfx_color_t*   colors;        // Lighting cache or baked colors, NULL for textured models
+    uint32_t*      color_stamps;  // A color is valid while its stamp equals color_generation
+    uint32_t       color_generation;
+    uint32_t       lit_light_version;  // What the cached colors were lit with
+    uint32_t       lit_object_version;
+    mat4_t         lit_object_to_eye;
+    uint32_t       lit_prepared_version;
+    size_t         vertex_count;
+    size_t         strip_index_count;
+    size_t         strip_count;
+    size_t         triangle_count;
+    model_bounds_t bounds;        // In model space
+    model_lod_t    lod;
+    gfx_tid_t      tid;
+    bool           textured;
+    bool           prelit;        // Colors are baked, nothing is lit at runtime
+    model_mid_t    mid;
 } model_t;
 
 void model_initialize(void);
 
 model_mid_t model_load_obj(const char* asset, gfx_tid_t tid, bool textured);
+model_mid_t model_load_bin(const char* asset, gfx_tid_t tid, bool textured);
+model_mid_t model_create_lod(const model_mid_t* levels, const float* thresholds, size_t count);
 void        model_free_obj(model_mid_t mid);
 
+// NULL if there is no such model
+const model_t* model_get(model_mid_t mid);
+
 void model_render_obj(model_mid_t mid);
+void model_render_instances(model_mid_t mid, const mat4_t* transforms, size_t count);
 
 #endif
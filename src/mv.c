@@ -5,6 +5,8 @@
 // Date:        2023/12/08
 // ============================================================================
 
+#define DEBUG_CHANNEL DEBUG_CHANNEL_MV
+
 #include "config.h"
 
 #include "debug.h"
@@ -12,14 +14,33 @@
 #include "mv.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
+#ifdef CONFIG_TARGET_SH4
+    #include <dc/matrix.h>
+#endif
+
 // Global so it can be directly accessed from inlined function
 // Since the transform will need to be applied to every vertex
 mat4_t g_mv_transform;
 
+mv_plane_t g_mv_frustum[MV_FRUSTUM_PLANES];
+
+vec3_t g_mv_eye;
+float  g_mv_eye_w;
+
 static mat4_t modelview;
 static mat4_t projection;
+static mat4_t view_transform; // projection * modelview, as of the last mv_calculate_transform
+static mat4_t view_modelview; // modelview, as of the last mv_calculate_transform
+static mv_plane_t view_frustum[MV_FRUSTUM_PLANES]; // and the frustum and eye of view_transform
+static vec3_t view_eye;
+static float  view_eye_w;
+static vec3_t view_eye_in_eye; // view_eye after the modelview
+static mat4_t object_to_eye;   // Modelview part of g_mv_transform
+static mat4_t object_from_eye; // and its inverse
+static uint32_t object_version; // Bumped whenever object_to_eye changes
 
 static mat4_t modelview_stack[CONFIG_MATRIX_STACK_SIZE];
 static mat4_t projection_stack[CONFIG_MATRIX_STACK_SIZE];
@@ -29,6 +50,8 @@ static size_t projection_top;
 
 static mv_matrix_model_t model;
 
+#define MV_FRUSTUM_NEAR_W (1e-3f) // Closest w that is still drawn
+
 // ============================================================================
 // Internal Inline Matrix Operations
 // ============================================================================
@@ -222,9 +245,441 @@ void mv_perspective(float fovy, float aspect, float near, float far)
     mv_frustum(-x, x, -y, y, near, far);
 }
 
+// Perspective for a modelview that already works in screen units, with the
+// viewer at z = 0 looking down +z. Points at depth distance keep their x and
+// y, nearer ones spread out from (center_x, center_y). w is z / distance, so
+// the 1/w written by the batch transform is larger the nearer a vertex is.
+void mv_perspective_screen(float center_x, float center_y, float distance)
+{
+    mat4_t p =  {{0.0f}};
+    p.e[0]   =  1.0f;
+    p.e[5]   =  1.0f;
+    p.e[8]   =  center_x / distance;
+    p.e[9]   =  center_y / distance;
+    p.e[10]  =  1.0f;
+    p.e[11]  =  1.0f / distance;
+    p.e[12]  = -center_x;
+    p.e[13]  = -center_y;
+
+    mat4_t m = ASSIGN_ACTIVE_MATRIX();
+
+    m = matrix_multiply(m, p);
+
+    ASSIGN_TO_ACTIVE_MATRIX(m);
+}
+
+// Row i of the transform, as a plane
+INLINE mv_plane_t matrix_row(const mat4_t* m, int i)
+{
+    return (mv_plane_t){{m->e[0+i], m->e[4+i], m->e[8+i]}, m->e[12+i]};
+}
+
+INLINE mv_plane_t plane_combine(mv_plane_t a, float sa, mv_plane_t b, float sb)
+{
+    return (mv_plane_t){mv_vec_add(mv_vec_scale(a.normal, sa), mv_vec_scale(b.normal, sb)),
+                        a.distance * sa + b.distance * sb};
+}
+
+// Transformed vertices end up in screen space as {x/w, y/w}, so the visible
+// region is 0 <= x <= W*w and 0 <= y <= H*w with w > 0. Each inequality is a
+// plane in the space of the untransformed vertices (Gribb/Hartmann).
+static void calculate_frustum(const mat4_t* m)
+{
+    mv_plane_t x = matrix_row(m, 0);
+    mv_plane_t y = matrix_row(m, 1);
+    mv_plane_t w = matrix_row(m, 3);
+
+    g_mv_frustum[0] = x;                                           // Left
+    g_mv_frustum[1] = plane_combine(w, CONFIG_SCREEN_W, x, -1.0f); // Right
+    g_mv_frustum[2] = y;                                           // Top
+    g_mv_frustum[3] = plane_combine(w, CONFIG_SCREEN_H, y, -1.0f); // Bottom
+    g_mv_frustum[4] = w;                                           // Near
+    g_mv_frustum[4].distance -= MV_FRUSTUM_NEAR_W;
+
+    // Normalized so that sphere radii can be compared against the distances.
+    // A plane without a normal (w is constant without a perspective
+    // projection) only has its sign to give and is left alone.
+    for(int i = 0; i < MV_FRUSTUM_PLANES; i++) {
+        float length = mv_vec_length(g_mv_frustum[i].normal);
+
+        if(length > 1e-12f) {
+            g_mv_frustum[i].normal    = mv_vec_scale(g_mv_frustum[i].normal, 1.0f / length);
+            g_mv_frustum[i].distance /= length;
+        }
+    }
+}
+
+// The viewer is the point that every screen position projects from, i.e. the
+// one that the x, y and w rows all map to 0. That is the homogeneous cross
+// product of the three rows, whose sign is chosen so that for a triangle with
+// plane (n, -n.p), dot(plane, eye) has the sign of the triangle's screen area
+// (positive for clockwise, which the PVR draws).
+static void calculate_eye(const mat4_t* m)
+{
+    #define E(r, c) (m->e[(c)*4 + (r)])
+    #define DET3(c0, c1, c2) (E(0,c0) * (E(1,c1)*E(3,c2) - E(3,c1)*E(1,c2)) - \
+                              E(0,c1) * (E(1,c0)*E(3,c2) - E(3,c0)*E(1,c2)) + \
+                              E(0,c2) * (E(1,c0)*E(3,c1) - E(3,c0)*E(1,c1)))
+
+    float x =  DET3(1, 2, 3);
+    float y = -DET3(0, 2, 3);
+    float z =  DET3(0, 1, 3);
+    float w = -DET3(0, 1, 2);
+
+    #undef DET3
+    #undef E
+
+    float length = fsqrt(x*x + y*y + z*z);
+
+    if(fabsf(w) <= length * 1e-6f) {
+        g_mv_eye   = (length > 0.0f) ? (vec3_t){x / length, y / length, z / length} : (vec3_t){0.0f, 0.0f, 0.0f};
+        g_mv_eye_w = 0.0f;
+    } else {
+        // Scaled to w = +-1, the sign matters for the facing test
+        float scale = 1.0f / fabsf(w);
+        g_mv_eye   = (vec3_t){x * scale, y * scale, z * scale};
+        g_mv_eye_w = w * scale;
+    }
+}
+
+// Inverse of an affine matrix: the transposed cofactors of the 3x3 part over
+// its determinant, and the translation taken back through that.
+static mat4_t affine_inverse(const mat4_t* m)
+{
+    const float* e = m->e;
+    mat4_t       r = {{0.0f}};
+
+    r.e[0]  = e[5]*e[10] - e[9]*e[6];
+    r.e[4]  = e[8]*e[6]  - e[4]*e[10];
+    r.e[8]  = e[4]*e[9]  - e[8]*e[5];
+    r.e[1]  = e[9]*e[2]  - e[1]*e[10];
+    r.e[5]  = e[0]*e[10] - e[8]*e[2];
+    r.e[9]  = e[8]*e[1]  - e[0]*e[9];
+    r.e[2]  = e[1]*e[6]  - e[5]*e[2];
+    r.e[6]  = e[4]*e[2]  - e[0]*e[6];
+    r.e[10] = e[0]*e[5]  - e[4]*e[1];
+
+    float det = e[0]*r.e[0] + e[4]*r.e[1] + e[8]*r.e[2];
+
+    if(det == 0.0f) {
+        return r; // Flattened, nothing sensible to return
+    }
+
+    float inv = 1.0f / det;
+
+    for(int i = 0; i < 11; i++) {
+        r.e[i] *= inv;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        r.e[12+i] = -(r.e[0+i]*e[12] + r.e[4+i]*e[13] + r.e[8+i]*e[14]);
+    }
+
+    r.e[15] = 1.0f;
+
+    return r;
+}
+
+// Takes the modelview part of a new transform. Nothing is redone, and the
+// version stays, if it is the same as the last one.
+static void set_object_to_eye(const mat4_t* m)
+{
+    if(memcmp(m, &object_to_eye, sizeof(mat4_t)) == 0) {
+        return;
+    }
+
+    object_to_eye   = *m;
+    object_from_eye = affine_inverse(m);
+    object_version++;
+}
+
+// Affine m applied to the homogeneous point (p, w)
+INLINE vec3_t affine_transform(const mat4_t* m, vec3_t p, float w)
+{
+    const float* e = m->e;
+
+    return (vec3_t){e[0]*p.x + e[4]*p.y + e[8] *p.z + e[12]*w,
+                    e[1]*p.x + e[5]*p.y + e[9] *p.z + e[13]*w,
+                    e[2]*p.x + e[6]*p.y + e[10]*p.z + e[14]*w};
+}
+
 void mv_calculate_transform(void)
 {
-    g_mv_transform = matrix_multiply(projection, modelview);
+    view_transform  = matrix_multiply(projection, modelview);
+    view_modelview  = modelview;
+    g_mv_transform  = view_transform;
+    set_object_to_eye(&view_modelview);
+    calculate_frustum(&g_mv_transform);
+    calculate_eye(&g_mv_transform);
+
+    memcpy(view_frustum, g_mv_frustum, sizeof(view_frustum));
+    view_eye        = g_mv_eye;
+    view_eye_w      = g_mv_eye_w;
+    view_eye_in_eye = affine_transform(&view_modelview, g_mv_eye, g_mv_eye_w);
+}
+
+mv_cull_t mv_frustum_test_instance(const mat4_t* instance, vec3_t center, float radius)
+{
+    const float* e = instance->e;
+
+    // Radius grows with the longest axis of the instance
+    float sx = e[0]*e[0] + e[1]*e[1] + e[2] *e[2];
+    float sy = e[4]*e[4] + e[5]*e[5] + e[6] *e[6];
+    float sz = e[8]*e[8] + e[9]*e[9] + e[10]*e[10];
+    float s  = (sx > sy) ? sx : sy;
+
+    center = affine_transform(instance, center, 1.0f);
+    radius = radius * fsqrt((s > sz) ? s : sz);
+
+    mv_cull_t result = MV_CULL_INSIDE;
+
+    for(int i = 0; i < MV_FRUSTUM_PLANES; i++) {
+        float d = mv_vec_scalar_product(view_frustum[i].normal, center) + view_frustum[i].distance;
+
+        if(d < -radius) {
+            return MV_CULL_OUTSIDE;
+        }
+        if(d < radius) {
+            result = MV_CULL_INTERSECT;
+        }
+    }
+
+    return result;
+}
+
+// Same as pushing the modelview, multiplying it with instance, calculating
+// the transform and popping again, but without redoing projection * modelview
+// for every instance, and with the eye and the frustum taken from those of
+// the plain transform instead of worked out from scratch. g_mv_frustum is
+// only updated when frustum is set, instances found to be inside by
+// mv_frustum_test_instance have nothing left to test. NULL goes back to the
+// plain transform.
+void mv_calculate_transform_instance(const mat4_t* instance, bool frustum)
+{
+    if(instance == NULL) {
+        g_mv_transform = view_transform;
+        set_object_to_eye(&view_modelview);
+        memcpy(g_mv_frustum, view_frustum, sizeof(view_frustum));
+        g_mv_eye   = view_eye;
+        g_mv_eye_w = view_eye_w;
+        return;
+    }
+
+    const float* e = instance->e;
+    mat4_t       m = matrix_multiply(view_modelview, *instance);
+
+    g_mv_transform = matrix_multiply(view_transform, *instance);
+    set_object_to_eye(&m);
+
+    // The eye is the point every row of the transform but z maps to 0, i.e.
+    // the view's eye taken back through the instance. Its sign follows that of
+    // the screen area, which a mirroring instance flips.
+    float det = e[0] * (e[5]*e[10] - e[9]*e[6]) - e[4] * (e[1]*e[10] - e[9]*e[2]) + e[8] * (e[1]*e[6] - e[5]*e[2]);
+
+    g_mv_eye   = affine_transform(&object_from_eye, view_eye_in_eye, view_eye_w);
+    g_mv_eye_w = view_eye_w;
+
+    if(det < 0.0f) {
+        g_mv_eye   = mv_vec_scale(g_mv_eye, -1.0f);
+        g_mv_eye_w = -g_mv_eye_w;
+    }
+
+    if(frustum == false) {
+        return;
+    }
+
+    // A plane (n, d) of the view is (A^T n, n.t + d) for vertices that the
+    // instance A takes there, normalized again
+    for(int i = 0; i < MV_FRUSTUM_PLANES; i++) {
+        const mv_plane_t* p = &view_frustum[i];
+        mv_plane_t        q = {{e[0]*p->normal.x + e[1]*p->normal.y + e[2] *p->normal.z,
+                                e[4]*p->normal.x + e[5]*p->normal.y + e[6] *p->normal.z,
+                                e[8]*p->normal.x + e[9]*p->normal.y + e[10]*p->normal.z},
+                               mv_vec_scalar_product(p->normal, (vec3_t){e[12], e[13], e[14]}) + p->distance};
+        float             length = mv_vec_length(q.normal);
+
+        if(length > 1e-12f) {
+            q.normal    = mv_vec_scale(q.normal, 1.0f / length);
+            q.distance /= length;
+        }
+
+        g_mv_frustum[i] = q;
+    }
+}
+
+// Eye space (after the modelview, before the projection) to the space of the
+// vertices that g_mv_transform applies to, e.g. to move lights into a model
+vec3_t mv_eye_to_object(vec3_t p)
+{
+    const float* e = object_from_eye.e;
+
+    return (vec3_t){e[0]*p.x + e[4]*p.y + e[8] *p.z + e[12],
+                    e[1]*p.x + e[5]*p.y + e[9] *p.z + e[13],
+                    e[2]*p.x + e[6]*p.y + e[10]*p.z + e[14]};
+}
+
+vec3_t mv_eye_to_object_direction(vec3_t d)
+{
+    const float* e = object_from_eye.e;
+
+    return (vec3_t){e[0]*d.x + e[4]*d.y + e[8] *d.z,
+                    e[1]*d.x + e[5]*d.y + e[9] *d.z,
+                    e[2]*d.x + e[6]*d.y + e[10]*d.z};
+}
+
+// Changes only when the modelview part of g_mv_transform really does, so
+// anything derived from it (like lighting) can be kept until then
+uint32_t mv_get_object_version(void)
+{
+    return object_version;
+}
+
+const mat4_t* mv_get_object_to_eye(void)
+{
+    return &object_to_eye;
+}
+
+// ============================================================================
+// Batched Vertex Transform
+// ============================================================================
+// Applies g_mv_transform to n positions. The matrix is loaded once per batch
+// and the result is written as {x/w, y/w, 1/w}, 1/w being the depth value the
+// PVR wants. Strides are in bytes so positions can be read from and written to
+// arrays of larger structures (e.g. gfx_vertex_t), in place if desired. The
+// indexed variants only transform the listed elements of in and out.
+
+// Declares a batch's copy of the matrix, aligned for batch_load
+#define BATCH_MATRIX const mat4_t __attribute__((aligned(8)))
+
+#ifdef CONFIG_TARGET_SH4
+
+// The matrix lives in XMTRX for the whole batch. mat_load reads it in pairs
+// of floats with fmov.d, so m has to be 8 byte aligned (BATCH_MATRIX).
+INLINE void batch_load(const mat4_t* m)
+{
+    mat_load((matrix_t*)m);
+}
+
+INLINE void batch_transform(const mat4_t* m, float vx, float vy, float vz, vec3_t* o)
+{
+    (void)m;
+
+    register float x __asm__("fr12") = vx;
+    register float y __asm__("fr13") = vy;
+    register float z __asm__("fr14") = vz;
+    register float w __asm__("fr15") = 1.0f;
+
+    __asm__ __volatile__("ftrv xmtrx, fv12\n"
+                         : "+f" (x), "+f" (y), "+f" (z), "+f" (w));
+
+    // fsrra(w*w) gives 1/|w| without a divide. Vertices behind the
+    // camera (w < 0) can't be drawn by the PVR anyway.
+    float invw = frsqrt(w * w);
+
+    o->x = x * invw;
+    o->y = y * invw;
+    o->z = invw;
+}
+
+#else // Portable fallback, reads the matrix from the caller's local copy in m
+
+INLINE void batch_load(const mat4_t* m)
+{
+    (void)m;
+}
+
+INLINE void batch_transform(const mat4_t* m, float vx, float vy, float vz, vec3_t* o)
+{
+    float x = m->e[0]*vx + m->e[4]*vy + m->e[8] *vz + m->e[12];
+    float y = m->e[1]*vx + m->e[5]*vy + m->e[9] *vz + m->e[13];
+    float w = m->e[3]*vx + m->e[7]*vy + m->e[11]*vz + m->e[15];
+
+    float invw = 1.0f / w;
+
+    o->x = x * invw;
+    o->y = y * invw;
+    o->z = invw;
+}
+
+#endif // CONFIG_TARGET_SH4
+
+// Vertex i of a batch is element indices[i] of in and out, or element i
+// without indices. Inlined into every caller so the check disappears.
+INLINE void transform_f32(const mat4_t* m, const uint8_t* src, size_t in_stride,
+                          uint8_t* dst, size_t out_stride, const uint16_t* indices, size_t n)
+{
+    batch_load(m);
+
+    for(size_t i = 0; i < n; i++) {
+        size_t        k = (indices != NULL) ? indices[i] : i;
+        const vec3_t* v = (const vec3_t*)(src + k * in_stride);
+        batch_transform(m, v->x, v->y, v->z, (vec3_t*)(dst + k * out_stride));
+    }
+}
+
+INLINE void transform_s16(const mat4_t* m, const uint8_t* src, size_t in_stride,
+                          uint8_t* dst, size_t out_stride, const uint16_t* indices, size_t n)
+{
+    batch_load(m);
+
+    for(size_t i = 0; i < n; i++) {
+        size_t         k = (indices != NULL) ? indices[i] : i;
+        const int16_t* q = (const int16_t*)(src + k * in_stride);
+        batch_transform(m, (float)q[0], (float)q[1], (float)q[2], (vec3_t*)(dst + k * out_stride));
+    }
+}
+
+// For 16-bit quantized positions the real position is q * scale + offset.
+// The dequantization is folded into the matrix, so it costs nothing per
+// vertex beyond the int to float conversion.
+INLINE mat4_t dequantized_transform(vec3_t scale, vec3_t offset)
+{
+    mat4_t m = g_mv_transform;
+
+    for(int i = 0; i < 4; i++) {
+        m.e[12+i] += m.e[0+i]*offset.x + m.e[4+i]*offset.y + m.e[8+i]*offset.z;
+        m.e[0+i]  *= scale.x;
+        m.e[4+i]  *= scale.y;
+        m.e[8+i]  *= scale.z;
+    }
+
+    return m;
+}
+
+void mv_transform_batch(const vec3_t* in, vec3_t* out, size_t n)
+{
+    mv_transform_batch_strided(in, sizeof(vec3_t), out, sizeof(vec3_t), n);
+}
+
+void mv_transform_batch_strided(const void* in, size_t in_stride, void* out, size_t out_stride, size_t n)
+{
+    BATCH_MATRIX m = g_mv_transform; // Local copy, so it isn't reloaded after every store
+
+    transform_f32(&m, (const uint8_t*)in, in_stride, (uint8_t*)out, out_stride, NULL, n);
+}
+
+void mv_transform_batch_indexed(const void* in, size_t in_stride, void* out, size_t out_stride,
+                                const uint16_t* indices, size_t n)
+{
+    BATCH_MATRIX m = g_mv_transform;
+
+    transform_f32(&m, (const uint8_t*)in, in_stride, (uint8_t*)out, out_stride, indices, n);
+}
+
+void mv_transform_batch_s16(const void* in, size_t in_stride, vec3_t scale, vec3_t offset,
+                            void* out, size_t out_stride, size_t n)
+{
+    BATCH_MATRIX m = dequantized_transform(scale, offset);
+
+    transform_s16(&m, (const uint8_t*)in, in_stride, (uint8_t*)out, out_stride, NULL, n);
+}
+
+void mv_transform_batch_s16_indexed(const void* in, size_t in_stride, vec3_t scale, vec3_t offset,
+                                    void* out, size_t out_stride, const uint16_t* indices, size_t n)
+{
+    BATCH_MATRIX m = dequantized_transform(scale, offset);
+
+    transform_s16(&m, (const uint8_t*)in, in_stride, (uint8_t*)out, out_stride, indices, n);
 }
 
 mat4_t mv_get_matrix(mv_matrix_model_t m)
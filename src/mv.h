@@ -13,6 +13,8 @@
 #include "debug.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
 #include <dc/fmath.h>
 
 // Useful constants
@@ -45,6 +47,21 @@ typedef enum mv_matrix_model_t {
     MV_PROJECTION
 } mv_matrix_model_t;
 
+// Points p with dot(normal, p) + distance >= 0 are on the inside
+typedef struct mv_plane_t
+{
+    vec3_t normal;
+    float  distance;
+} mv_plane_t;
+
+typedef enum mv_cull_t {
+    MV_CULL_OUTSIDE,
+    MV_CULL_INTERSECT,
+    MV_CULL_INSIDE
+} mv_cull_t;
+
+#define MV_FRUSTUM_PLANES (5) // Left, right, top, bottom, near
+
 
 
 // ============================================================================
@@ -61,7 +78,23 @@ void mv_translate(float x, float y, float z);
 void mv_ortho(float left, float right, float bottom, float top, float near, float far);
 void mv_frustum(float left, float right, float bottom, float top, float near, float far);
 void mv_perspective(float fovy, float aspect, float near, float far);
+void mv_perspective_screen(float center_x, float center_y, float distance);
 void mv_calculate_transform(void);
+void mv_calculate_transform_instance(const mat4_t* instance, bool frustum);
+mv_cull_t mv_frustum_test_instance(const mat4_t* instance, vec3_t center, float radius);
+vec3_t mv_eye_to_object(vec3_t p);
+vec3_t mv_eye_to_object_direction(vec3_t d);
+uint32_t      mv_get_object_version(void);
+const mat4_t* mv_get_object_to_eye(void);
+
+void mv_transform_batch(const vec3_t* in, vec3_t* out, size_t n);
+void mv_transform_batch_strided(const void* in, size_t in_stride, void* out, size_t out_stride, size_t n);
+void mv_transform_batch_s16(const void* in, size_t in_stride, vec3_t scale, vec3_t offset,
+                            void* out, size_t out_stride, size_t n);
+void mv_transform_batch_indexed(const void* in, size_t in_stride, void* out, size_t out_stride,
+                                const uint16_t* indices, size_t n);
+void mv_transform_batch_s16_indexed(const void* in, size_t in_stride, vec3_t scale, vec3_t offset,
+                                    void* out, size_t out_stride, const uint16_t* indices, size_t n);
 
 mat4_t mv_get_matrix(mv_matrix_model_t m);
 
@@ -72,6 +105,15 @@ void mv_print_matrix(mat4_t m);
 // ============================================================================
 extern mat4_t g_mv_transform;
 
+// View frustum of g_mv_transform, in the space of the vertices it transforms
+extern mv_plane_t g_mv_frustum[MV_FRUSTUM_PLANES];
+
+// Viewer of g_mv_transform in the same space, as the homogeneous point
+// (g_mv_eye, g_mv_eye_w). g_mv_eye_w is 0 for parallel projections, where
+// g_mv_eye is the direction towards the viewer.
+extern vec3_t g_mv_eye;
+extern float  g_mv_eye_w;
+
 // ============================================================================
 // Vector Operations
 // ============================================================================
@@ -148,4 +190,75 @@ INLINE vec3_t mv_mat_vec_transform(vec3_t v)
     return (vec3_t){x/w, y/w, z/w}; // Do perspective divide here
 }
 
+// Approximate radius in pixels of a sphere after g_mv_transform, using the
+// larger scale of the x and y rows
+INLINE float mv_projected_radius(vec3_t center, float radius)
+{
+    #define m g_mv_transform
+
+    float w  = m.e[3]*center.x + m.e[7]*center.y + m.e[11]*center.z + m.e[15];
+    float sx = m.e[0]*m.e[0] + m.e[4]*m.e[4] + m.e[8]*m.e[8];
+    float sy = m.e[1]*m.e[1] + m.e[5]*m.e[5] + m.e[9]*m.e[9];
+
+    #undef m
+
+    return radius * fsqrt(sx > sy ? sx : sy) / fabsf(w);
+}
+
+// ============================================================================
+// Frustum Culling - Against the planes from the last mv_calculate_transform
+// ============================================================================
+
+INLINE mv_cull_t mv_frustum_test_sphere(vec3_t center, float radius)
+{
+    mv_cull_t result = MV_CULL_INSIDE;
+
+    for(int i = 0; i < MV_FRUSTUM_PLANES; i++) {
+        float d = mv_vec_scalar_product(g_mv_frustum[i].normal, center) + g_mv_frustum[i].distance;
+
+        if(d < -radius) {
+            return MV_CULL_OUTSIDE;
+        }
+        if(d < radius) {
+            result = MV_CULL_INTERSECT;
+        }
+    }
+
+    return result;
+}
+
+// True if a triangle in the plane p, with its normal from the winding, faces
+// the viewer and is drawn. fipr does the whole 4D dot product on SH4.
+INLINE bool mv_plane_test_frontfacing(const mv_plane_t* p)
+{
+    return fipr(p->normal.x, p->normal.y, p->normal.z, p->distance,
+                g_mv_eye.x,  g_mv_eye.y,  g_mv_eye.z,  g_mv_eye_w) > 0.0f;
+}
+
+INLINE mv_cull_t mv_frustum_test_box(vec3_t min, vec3_t max)
+{
+    mv_cull_t result = MV_CULL_INSIDE;
+
+    for(int i = 0; i < MV_FRUSTUM_PLANES; i++) {
+        const mv_plane_t* p = &g_mv_frustum[i];
+
+        // Corners furthest along and against the plane normal
+        vec3_t far  = {p->normal.x >= 0.0f ? max.x : min.x,
+                       p->normal.y >= 0.0f ? max.y : min.y,
+                       p->normal.z >= 0.0f ? max.z : min.z};
+        vec3_t near = {p->normal.x >= 0.0f ? min.x : max.x,
+                       p->normal.y >= 0.0f ? min.y : max.y,
+                       p->normal.z >= 0.0f ? min.z : max.z};
+
+        if(mv_vec_scalar_product(p->normal, far) + p->distance < 0.0f) {
+            return MV_CULL_OUTSIDE;
+        }
+        if(mv_vec_scalar_product(p->normal, near) + p->distance < 0.0f) {
+            result = MV_CULL_INTERSECT;
+        }
+    }
+
+    return result;
+}
+
 #endif // MV_H
@@ -0,0 +1,159 @@
+// ============================================================================
+// File:        prof.c
+// Description: Frame profiler (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#define DEBUG_CHANNEL DEBUG_CHANNEL_CORE
+
+#include "config.h"
+
+#include "prof.h"
+#include "debug.h"
+#include "graphics.h"
+
+#include <kos.h>
+#include <stddef.h>
+
+#ifdef CONFIG_PROF_ENABLED
+
+typedef struct prof_frame_t
+{
+    uint32_t us[PROF_TIMER_COUNT];
+    uint32_t render_ms;    // PVR render time, from pvr_get_stats
+    uint32_t vertex_bytes; // TA vertex buffer used
+} prof_frame_t;
+
+typedef struct prof_summary_t
+{
+    uint32_t min, max;
+    float    avg;
+} prof_summary_t;
+
+static const char* timer_name[PROF_TIMER_COUNT] = {
+    "Input", "Transform", "Lighting", "Submit", "PVR wait", "Frame"
+};
+
+static prof_frame_t frames[CONFIG_PROF_FRAMES]; // Ring buffer of finished frames
+static size_t       frame_next;
+static size_t       frame_count;
+
+static prof_frame_t current;
+static uint64_t     started[PROF_TIMER_COUNT];
+static uint64_t     frame_started;
+static float        frame_rate;
+
+void prof_initialize(void)
+{
+    frame_next    = 0;
+    frame_count   = 0;
+    frame_started = 0;
+    frame_rate    = 0.0f;
+
+    debug_printf(DEBUG_INFO, "Initialized profiler.\n");
+    debug_printf(DEBUG_BLANK,"History: %d frames\n", CONFIG_PROF_FRAMES);
+}
+
+void prof_frame_begin(void)
+{
+    frame_started = timer_us_gettime64();
+
+    for(size_t i = 0; i < PROF_TIMER_COUNT; i++) {
+        current.us[i] = 0;
+    }
+}
+
+void prof_frame_end(void)
+{
+    pvr_stats_t stats;
+
+    if(pvr_get_stats(&stats) == 0) {
+        current.render_ms    = (uint32_t)stats.rnd_last_time;
+        current.vertex_bytes = (uint32_t)stats.vtx_buffer_used;
+        frame_rate           = stats.frame_rate;
+    }
+
+    current.us[PROF_FRAME] = (uint32_t)(timer_us_gettime64() - frame_started);
+
+    frames[frame_next] = current;
+    frame_next = (frame_next + 1) % CONFIG_PROF_FRAMES;
+
+    if(frame_count < CONFIG_PROF_FRAMES) {
+        frame_count++;
+    }
+}
+
+void prof_begin(prof_timer_t timer)
+{
+    started[timer] = timer_us_gettime64();
+}
+
+void prof_end(prof_timer_t timer)
+{
+    current.us[timer] += (uint32_t)(timer_us_gettime64() - started[timer]);
+}
+
+static prof_summary_t summarize(size_t offset)
+{
+    prof_summary_t s = {UINT32_MAX, 0, 0.0f};
+    uint64_t       total = 0;
+
+    for(size_t i = 0; i < frame_count; i++) {
+        uint32_t value = *(const uint32_t*)((const uint8_t*)&frames[i] + offset);
+        if(value < s.min) s.min = value;
+        if(value > s.max) s.max = value;
+        total += value;
+    }
+
+    if(frame_count == 0) {
+        s.min = 0;
+    } else {
+        s.avg = (float)total / frame_count;
+    }
+
+    return s;
+}
+
+#define TIMER_OFFSET(i) (offsetof(prof_frame_t, us) + sizeof(uint32_t) * (i))
+
+void prof_draw_overlay(gfx_tid_t font, float x, float y)
+{
+    const float size = 12.0f;
+
+    gfx_font_printf(font, size, x, y, "%-9s %6s %6s %6s", "us", "min", "avg", "max");
+    y += size;
+
+    for(size_t i = 0; i < PROF_TIMER_COUNT; i++) {
+        prof_summary_t s = summarize(TIMER_OFFSET(i));
+        gfx_font_printf(font, size, x, y, "%-9s %6d %6d %6d", timer_name[i], (int)s.min, (int)s.avg, (int)s.max);
+        y += size;
+    }
+
+    prof_summary_t render = summarize(offsetof(prof_frame_t, render_ms));
+    prof_summary_t vertex = summarize(offsetof(prof_frame_t, vertex_bytes));
+
+    gfx_font_printf(font, size, x, y, "PVR %.1f fps, render %d ms, TA %d KiB", frame_rate, (int)render.max, (int)(vertex.max / 1024));
+}
+
+void prof_dump(void)
+{
+#ifdef CONFIG_DEBUG_LOG_ENABLED
+    debug_printf(DEBUG_INFO, "Profile of the last %d frames (us):\n", frame_count);
+    debug_printf(DEBUG_BLANK,"%-9s %8s %8s %8s\n", "Timer", "min", "avg", "max");
+
+    for(size_t i = 0; i < PROF_TIMER_COUNT; i++) {
+        prof_summary_t s = summarize(TIMER_OFFSET(i));
+        debug_printf(DEBUG_BLANK,"%-9s %8d %8.1f %8d\n", timer_name[i], (int)s.min, s.avg, (int)s.max);
+    }
+
+    prof_summary_t render = summarize(offsetof(prof_frame_t, render_ms));
+    prof_summary_t vertex = summarize(offsetof(prof_frame_t, vertex_bytes));
+
+    debug_printf(DEBUG_BLANK,"PVR frame rate: %.1f\n", frame_rate);
+    debug_printf(DEBUG_BLANK,"PVR render:     %d/%.1f/%d ms\n", (int)render.min, render.avg, (int)render.max);
+    debug_printf(DEBUG_BLANK,"TA buffer used: %d/%.0f/%d bytes\n", (int)vertex.min, vertex.avg, (int)vertex.max);
+#endif
+}
+
+#endif // CONFIG_PROF_ENABLED
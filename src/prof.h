@@ -0,0 +1,58 @@
+// ============================================================================
+// File:        prof.h
+// Description: Frame profiler (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#ifndef PROF_H
+#define PROF_H
+
+#include "config.h"
+
+#include "graphics.h"
+
+#include <stdint.h>
+
+typedef enum prof_timer_t
+{
+    PROF_INPUT,     // Controller read
+    PROF_TRANSFORM, // Vertex transform
+    PROF_LIGHTING,  // Vertex lighting
+    PROF_SUBMIT,    // Sending primitives to the TA
+    PROF_WAIT,      // Stalled in pvr_wait_ready
+    PROF_FRAME,     // prof_frame_begin to prof_frame_end
+    PROF_TIMER_COUNT
+} prof_timer_t;
+
+void prof_initialize(void);
+void prof_frame_begin(void);
+void prof_frame_end(void);
+
+// A timer may be started and stopped many times a frame, the total counts
+void prof_begin(prof_timer_t timer);
+void prof_end(prof_timer_t timer);
+
+// Min/avg/max over the last CONFIG_PROF_FRAMES frames
+void prof_draw_overlay(gfx_tid_t font, float x, float y);
+void prof_dump(void);
+
+// Times the statement or block that follows, e.g. PROF_SCOPE(PROF_INPUT) { ... }
+// Leaving it with break, return or goto skips prof_end.
+#define PROF_SCOPE(timer) \
+    for(int prof_scope_ = (prof_begin(timer), 1); prof_scope_; prof_scope_ = 0, prof_end(timer))
+
+#ifndef CONFIG_PROF_ENABLED
+    #define prof_initialize()
+    #define prof_frame_begin()
+    #define prof_frame_end()
+    #define prof_begin(x)
+    #define prof_end(x)
+    #define prof_draw_overlay(x, y, z)
+    #define prof_dump()
+    #undef  PROF_SCOPE
+    #define PROF_SCOPE(timer)
+#endif
+
+
+#endif // PROF_H
@@ -0,0 +1,228 @@
+// ============================================================================
+// File:        strip.c
+// Description: Triangle stripification (source)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#define DEBUG_CHANNEL DEBUG_CHANNEL_MODEL
+
+#include "config.h"
+
+#include "strip.h"
+
+#include "debug.h"
+#include "mem.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Greedy stripifier. Strips follow the PVR (and GL) convention, where
+// triangle j of a strip is {s[j], s[j+1], s[j+2]} for even j and
+// {s[j+1], s[j], s[j+2]} for odd j, so every input triangle keeps its
+// winding and backface culling still works.
+
+typedef struct strip_edge_t
+{
+    uint32_t key;      // (from << 16) | to
+    uint32_t triangle;
+} strip_edge_t;
+
+typedef struct strip_context_t
+{
+    const uint16_t* triangles;
+    strip_edge_t*   edges;
+    size_t          edge_count;
+    uint32_t*       stamp;     // Trial that last claimed a triangle, 0 if none
+    bool*           used;      // Triangle is already part of an emitted strip
+    uint16_t*       trial;     // Indices of the strip being grown
+    uint32_t*       claimed;   // Triangles of the strip being grown
+} strip_context_t;
+
+// Edges sharing a key stay in triangle order, which qsort alone wouldn't
+// promise, so util/obj_to_mdl.py can bake the very same strips
+static int edge_compare(const void* a, const void* b)
+{
+    const strip_edge_t* ea = (const strip_edge_t*)a;
+    const strip_edge_t* eb = (const strip_edge_t*)b;
+
+    if(ea->key != eb->key) {
+        return (ea->key > eb->key) - (ea->key < eb->key);
+    }
+
+    return (ea->triangle > eb->triangle) - (ea->triangle < eb->triangle);
+}
+
+// Finds a free triangle that contains the directed edge from -> to and
+// returns its remaining vertex, or -1 if there is none
+static int32_t find_next(strip_context_t* c, uint16_t from, uint16_t to, uint32_t trial, uint32_t* triangle)
+{
+    uint32_t key = ((uint32_t)from << 16) | to;
+    size_t   lo  = 0;
+    size_t   hi  = c->edge_count;
+
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(c->edges[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for(; lo < c->edge_count && c->edges[lo].key == key; lo++) {
+        uint32_t t = c->edges[lo].triangle;
+
+        if(c->used[t] || c->stamp[t] == trial) {
+            continue;
+        }
+
+        const uint16_t* v = &c->triangles[3*t];
+        *triangle = t;
+
+        if(v[0] == from) return v[2];
+        if(v[1] == from) return v[0];
+        return v[1];
+    }
+
+    return -1;
+}
+
+// Grows a strip from triangle t, starting at the given corner.
+// Returns the number of indices written to c->trial, the triangles it
+// covers are in c->claimed.
+static size_t grow(strip_context_t* c, uint32_t t, int corner, uint32_t trial)
+{
+    const uint16_t* v = &c->triangles[3*t];
+    size_t n = 0;
+
+    c->trial[n++] = v[corner];
+    c->trial[n++] = v[(corner + 1) % 3];
+    c->trial[n++] = v[(corner + 2) % 3];
+    c->stamp[t]   = trial;
+    c->claimed[0] = t;
+
+    while(n < STRIP_MAX_LENGTH) {
+        uint16_t a = c->trial[n-2];
+        uint16_t b = c->trial[n-1];
+        uint32_t next;
+        int32_t  x;
+
+        if(((n - 2) & 1) == 0) {
+            x = find_next(c, a, b, trial, &next);
+        } else {
+            x = find_next(c, b, a, trial, &next);
+        }
+
+        if(x < 0) {
+            break;
+        }
+
+        c->claimed[n-2] = next;
+        c->trial[n++]   = (uint16_t)x;
+        c->stamp[next]  = trial;
+    }
+
+    return n;
+}
+
+bool strip_build(const uint16_t* triangles, size_t triangle_count, strip_list_t* out)
+{
+    strip_context_t c;
+    size_t edge_count = 0;
+
+    memset(out, 0, sizeof(*out));
+
+    c.triangles = triangles;
+    c.edges     = mem_malloc(MEM_TAG_SCRATCH, sizeof(strip_edge_t) * (triangle_count * 3 + 1));
+    c.stamp     = mem_calloc(MEM_TAG_SCRATCH, triangle_count + 1, sizeof(uint32_t));
+    c.used      = mem_calloc(MEM_TAG_SCRATCH, triangle_count + 1, sizeof(bool));
+    c.trial     = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * STRIP_MAX_LENGTH);
+    c.claimed   = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint32_t) * STRIP_MAX_LENGTH);
+
+    // A strip never has more indices than 3 per triangle, nor more strips than triangles
+    out->indices = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * (triangle_count * 3 + 1));
+    out->lengths = mem_malloc(MEM_TAG_SCRATCH, sizeof(uint16_t) * (triangle_count + 1));
+
+    if(c.edges == NULL || c.stamp == NULL || c.used == NULL || c.trial == NULL || c.claimed == NULL ||
+       out->indices == NULL || out->lengths == NULL) {
+        debug_printf(DEBUG_ERROR, "Failed to allocate memory for stripification.\n");
+        mem_free(MEM_TAG_SCRATCH, c.edges);
+        mem_free(MEM_TAG_SCRATCH, c.stamp);
+        mem_free(MEM_TAG_SCRATCH, c.used);
+        mem_free(MEM_TAG_SCRATCH, c.trial);
+        mem_free(MEM_TAG_SCRATCH, c.claimed);
+        strip_free(out);
+        return false;
+    }
+
+    for(size_t t = 0; t < triangle_count; t++) {
+        const uint16_t* v = &triangles[3*t];
+
+        // Degenerate triangles produce nothing visible, drop them
+        if(v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) {
+            c.used[t] = true;
+            continue;
+        }
+
+        for(int i = 0; i < 3; i++) {
+            c.edges[edge_count].key      = ((uint32_t)v[i] << 16) | v[(i + 1) % 3];
+            c.edges[edge_count].triangle = (uint32_t)t;
+            edge_count++;
+        }
+    }
+
+    qsort(c.edges, edge_count, sizeof(strip_edge_t), edge_compare);
+    c.edge_count = edge_count;
+
+    uint32_t trial = 0;
+
+    for(size_t t = 0; t < triangle_count; t++) {
+        if(c.used[t]) {
+            continue;
+        }
+
+        // Try every starting corner and keep the longest strip
+        int    best_corner = 0;
+        size_t best_length = 0;
+
+        for(int corner = 0; corner < 3; corner++) {
+            size_t length = grow(&c, (uint32_t)t, corner, ++trial);
+            if(length > best_length) {
+                best_length = length;
+                best_corner = corner;
+            }
+        }
+
+        size_t length = grow(&c, (uint32_t)t, best_corner, ++trial);
+
+        for(size_t i = 0; i < length - 2; i++) {
+            c.used[c.claimed[i]] = true;
+        }
+
+        memcpy(&out->indices[out->index_count], c.trial, sizeof(uint16_t) * length);
+        out->lengths[out->strip_count++] = (uint16_t)length;
+        out->index_count += length;
+    }
+
+    mem_free(MEM_TAG_SCRATCH, c.edges);
+    mem_free(MEM_TAG_SCRATCH, c.stamp);
+    mem_free(MEM_TAG_SCRATCH, c.used);
+    mem_free(MEM_TAG_SCRATCH, c.trial);
+    mem_free(MEM_TAG_SCRATCH, c.claimed);
+
+    // Shrinking can't fail in practice, but keep the old block if it does
+    uint16_t* indices = mem_realloc(MEM_TAG_SCRATCH, out->indices, sizeof(uint16_t) * (out->index_count + 1));
+    uint16_t* lengths = mem_realloc(MEM_TAG_SCRATCH, out->lengths, sizeof(uint16_t) * (out->strip_count + 1));
+    if(indices != NULL) out->indices = indices;
+    if(lengths != NULL) out->lengths = lengths;
+
+    return true;
+}
+
+void strip_free(strip_list_t* s)
+{
+    mem_free(MEM_TAG_SCRATCH, s->indices);
+    mem_free(MEM_TAG_SCRATCH, s->lengths);
+    memset(s, 0, sizeof(*s));
+}
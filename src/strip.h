@@ -0,0 +1,28 @@
+// ============================================================================
+// File:        strip.h
+// Description: Triangle stripification (header)
+// Author:      Shirobon
+// Date:        2026/10/17
+// ============================================================================
+
+#ifndef STRIP_H
+#define STRIP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define STRIP_MAX_LENGTH (65535)
+
+typedef struct strip_list_t
+{
+    uint16_t* indices;     // All strips back to back
+    uint16_t* lengths;     // Number of indices in each strip
+    size_t    index_count;
+    size_t    strip_count;
+} strip_list_t;
+
+bool strip_build(const uint16_t* triangles, size_t triangle_count, strip_list_t* out);
+void strip_free(strip_list_t* s);
+
+#endif // STRIP_H
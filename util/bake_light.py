@@ -0,0 +1,377 @@
+#!/usr/bin/env python3
+
+# Bakes static lighting of a Wavefront OBJ into the vertex colors of a binary
+# model, which model_render_obj then draws without lighting anything.
+#
+# Every vertex gets the diffuse light of a light rig, shadowed by the mesh
+# itself, plus the ambient light scaled by ambient occlusion: the fraction of
+# cosine weighted rays from the vertex that travel a given distance without
+# hitting the mesh. The math matches light.c, so baked and runtime lit models
+# look alike.
+#
+# The rig is a text file with one light per line, in model space. Colors are
+# 0-255 and scaled by intensity, like light_t. # starts a comment.
+#   ambient     r g b intensity
+#   directional dx dy dz r g b intensity                        (dx dy dz: direction of travel)
+#   point       x y z r g b intensity [range]
+#   spot        x y z dx dy dz r g b intensity inner outer [range] (half angles in degrees)
+#
+# Rays are cast against a bounding volume hierarchy, by one worker process per
+# core since Python threads would share a single interpreter lock.
+
+import math
+import multiprocessing
+import random
+import sys
+
+import obj_to_mdl
+
+LEAF_SIZE = 4
+
+def sub(a, b):
+    return (a[0] - b[0], a[1] - b[1], a[2] - b[2])
+
+def cross(a, b):
+    return (a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0])
+
+def dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+def normalize(a):
+    length = dot(a, a) ** 0.5
+    return (a[0] / length, a[1] / length, a[2] / length) if length > 0.0 else a
+
+# ============================================================================
+# Ray Casting
+# ============================================================================
+
+class BVH:
+    """Bounding volume hierarchy over triangles, answering whether a segment
+    hits any of them. Nodes are (min, max, first child or triangle, count),
+    count being 0 for inner nodes whose children are first and first + 1."""
+
+    def __init__(self, triangles):
+        self.triangles = []
+        self.nodes     = []
+
+        items = [(t, tuple(sum(p[i] for p in t) / 3 for i in range(3))) for t in triangles]
+        if items:
+            self.build(items)
+
+    def build(self, items):
+        stack = [(len(self.nodes), items)]
+        self.nodes.append(None)
+
+        while stack:
+            index, items = stack.pop()
+            lo = tuple(min(p[i] for t, _ in items for p in t) for i in range(3))
+            hi = tuple(max(p[i] for t, _ in items for p in t) for i in range(3))
+
+            if len(items) <= LEAF_SIZE:
+                self.nodes[index] = (lo, hi, len(self.triangles), len(items))
+                self.triangles.extend(t for t, _ in items)
+                continue
+
+            # Median split along the longest axis of the centroids
+            axis = max(range(3), key=lambda i: max(c[i] for _, c in items) - min(c[i] for _, c in items))
+            items.sort(key=lambda item: item[1][axis])
+            half = len(items) // 2
+
+            child = len(self.nodes)
+            self.nodes.extend((None, None))
+            self.nodes[index] = (lo, hi, child, 0)
+
+            stack.append((child, items[:half]))
+            stack.append((child + 1, items[half:]))
+
+    def occluded(self, origin, direction, distance):
+        if not self.nodes:
+            return False
+
+        inverse = tuple(1.0 / d if d != 0.0 else math.copysign(1e30, d) for d in direction)
+        stack   = [0]
+
+        while stack:
+            lo, hi, first, count = self.nodes[stack.pop()]
+
+            # Slab test against the node's box
+            near, far = 0.0, distance
+            for i in range(3):
+                t0 = (lo[i] - origin[i]) * inverse[i]
+                t1 = (hi[i] - origin[i]) * inverse[i]
+                if t0 > t1:
+                    t0, t1 = t1, t0
+                near, far = max(near, t0), min(far, t1)
+                if near > far:
+                    break
+            else:
+                if count == 0:
+                    stack.append(first)
+                    stack.append(first + 1)
+                    continue
+
+                for a, b, c in self.triangles[first:first + count]:
+                    if hit_triangle(origin, direction, distance, a, b, c):
+                        return True
+
+        return False
+
+def hit_triangle(origin, direction, distance, a, b, c):
+    # Moller-Trumbore, both sides count
+    e1 = sub(b, a)
+    e2 = sub(c, a)
+    p  = cross(direction, e2)
+    d  = dot(e1, p)
+    if abs(d) < 1e-12:
+        return False
+    f = 1.0 / d
+    s = sub(origin, a)
+    u = f * dot(s, p)
+    if u < 0.0 or u > 1.0:
+        return False
+    q = cross(s, e1)
+    v = f * dot(direction, q)
+    if v < 0.0 or u + v > 1.0:
+        return False
+    t = f * dot(e2, q)
+    return 0.0 < t < distance
+
+# ============================================================================
+# Lighting
+# ============================================================================
+
+def read_rig(path):
+    """Returns the lights of a rig file as dictionaries, colors premultiplied
+    by intensity and scaled to 0..1."""
+    lights = []
+
+    with open(path, "r") as handle:
+        for number, line in enumerate(handle, 1):
+            parts = line.split("#")[0].split()
+            if not parts:
+                continue
+            try:
+                kind   = parts[0]
+                values = [float(x) for x in parts[1:]]
+                counts = {"ambient": (4, 4), "directional": (7, 7), "point": (7, 8), "spot": (12, 13)}
+
+                if kind not in counts:
+                    raise ValueError(f"unknown light type {kind}")
+                if not counts[kind][0] <= len(values) <= counts[kind][1]:
+                    raise ValueError(f"{kind} takes {counts[kind][0]} to {counts[kind][1]} numbers")
+
+                light = {"type": kind, "range": 0.0}
+
+                if kind == "ambient":
+                    color, intensity = values[0:3], values[3]
+                elif kind == "directional":
+                    light["direction"] = normalize(tuple(values[0:3]))
+                    color, intensity   = values[3:6], values[6]
+                elif kind == "point":
+                    light["position"] = tuple(values[0:3])
+                    color, intensity  = values[3:6], values[6]
+                    light["range"]    = values[7] if len(values) > 7 else 0.0
+                else:
+                    light["position"]  = tuple(values[0:3])
+                    light["direction"] = normalize(tuple(values[3:6]))
+                    color, intensity   = values[6:9], values[9]
+                    light["cos_inner"] = math.cos(math.radians(values[10]))
+                    light["cos_outer"] = math.cos(math.radians(values[11]))
+                    light["range"]     = values[12] if len(values) > 12 else 0.0
+
+                light["color"] = tuple(intensity * c / 255.0 for c in color)
+                lights.append(light)
+            except ValueError as E:
+                raise ValueError(f"{path}:{number}: malformed light ({E})")
+
+    return lights
+
+def diffuse(light, position, normal, bvh, bias, shadows):
+    """Light arriving at a vertex from a single non-ambient light, as a factor
+    of its color."""
+    if light["type"] == "directional":
+        to_light = tuple(-d for d in light["direction"])
+        distance = math.inf
+        factor   = dot(normal, to_light)
+    else:
+        d        = sub(light["position"], position)
+        distance = dot(d, d) ** 0.5
+        if distance == 0.0:
+            return 0.0
+        to_light = tuple(x / distance for x in d)
+        factor   = dot(normal, to_light)
+        if light["range"] > 0.0:
+            factor *= max(0.0, 1.0 - (distance / light["range"]) ** 2)
+        if light["type"] == "spot":
+            spread = light["cos_inner"] - light["cos_outer"]
+            cone   = (-dot(to_light, light["direction"]) - light["cos_outer"]) / spread if spread > 1e-6 else 1e6
+            factor *= max(0.0, min(1.0, cone))
+
+    if factor <= 0.0:
+        return 0.0
+
+    origin = tuple(p + n * bias for p, n in zip(position, normal))
+    if shadows and bvh.occluded(origin, to_light, distance):
+        return 0.0
+
+    return factor
+
+def occlusion(position, normal, bvh, bias, rays, distance, rng):
+    """Fraction of cosine weighted rays that escape within distance."""
+    # Orthonormal basis around the normal
+    helper  = (1.0, 0.0, 0.0) if abs(normal[0]) < 0.9 else (0.0, 1.0, 0.0)
+    tangent = normalize(cross(helper, normal))
+    other   = cross(normal, tangent)
+    origin  = tuple(p + n * bias for p, n in zip(position, normal))
+    escaped = 0
+
+    for _ in range(rays):
+        u1, u2 = rng.random(), rng.random()
+        r, phi = u1 ** 0.5, 2.0 * math.pi * u2
+        x, y, z = r * math.cos(phi), r * math.sin(phi), (1.0 - u1) ** 0.5
+        direction = tuple(x * t + y * o + z * n for t, o, n in zip(tangent, other, normal))
+        if not bvh.occluded(origin, direction, distance):
+            escaped += 1
+
+    return escaped / rays if rays > 0 else 1.0
+
+# Set up once per worker process by start_worker
+worker = {}
+
+def start_worker(triangles, lights, options):
+    worker["bvh"]     = BVH(triangles)
+    worker["lights"]  = lights
+    worker["options"] = options
+
+def bake_vertices(chunk):
+    bvh, lights, options = worker["bvh"], worker["lights"], worker["options"]
+    colors = []
+
+    for index, position, normal in chunk:
+        # Seeded per vertex, so the result doesn't depend on the process count
+        rng = random.Random(index)
+        ao  = occlusion(position, normal, bvh, options["bias"], options["rays"], options["distance"], rng) if options["rays"] > 0 else 1.0
+        total = [0.0, 0.0, 0.0]
+
+        for light in lights:
+            if light["type"] == "ambient":
+                factor = ao
+            else:
+                factor = diffuse(light, position, normal, bvh, options["bias"], options["shadows"])
+            for i in range(3):
+                total[i] += factor * light["color"][i]
+
+        r, g, b = (int(min(1.0, c) * 255) for c in total)
+        colors.append(0xFF000000 | (r << 16) | (g << 8) | b)
+
+    return colors
+
+def vertex_normals(vertices, normals, indices):
+    """Unit normals per vertex. Vertices without one get the area weighted
+    normal of the triangles around their position."""
+    missing = [dot(n, n) == 0.0 for n in normals]
+    if any(missing):
+        around = {}
+        for i in range(0, len(indices), 3):
+            a, b, c = (vertices[k][0:3] for k in indices[i:i + 3])
+            n = cross(sub(b, a), sub(c, a))
+            for k in indices[i:i + 3]:
+                key = vertices[k][0:3]
+                around[key] = tuple(x + y for x, y in zip(around.get(key, (0.0, 0.0, 0.0)), n))
+        normals = [around.get(v[0:3], n) if m else n for v, n, m in zip(vertices, normals, missing)]
+
+    return [normalize(n) for n in normals]
+
+def bake(vertices, normals, indices, lights, rays, distance, shadows, jobs):
+    """Returns one 0xAARRGGBB color per vertex."""
+    positions = [v[0:3] for v in vertices]
+    normals   = vertex_normals(vertices, normals, indices)
+    triangles = [tuple(positions[k] for k in indices[i:i + 3]) for i in range(0, len(indices), 3)]
+
+    radius  = obj_to_mdl.compute_bounds(vertices)[9]
+    options = {"rays":     rays,
+               "distance": distance if distance > 0.0 else radius,
+               "bias":     1e-4 * max(radius, 1e-6),
+               "shadows":  shadows}
+
+    work   = [(i, positions[i], normals[i]) for i in range(len(vertices))]
+    size   = max(1, len(work) // (jobs * 8))
+    chunks = [work[i:i + size] for i in range(0, len(work), size)]
+
+    with multiprocessing.Pool(jobs, start_worker, (triangles, lights, options)) as pool:
+        return [color for colors in pool.map(bake_vertices, chunks) for color in colors]
+
+def main():
+    if(len(sys.argv) == 1):
+        print("No arguments specified. Use -h or --help for usage.")
+        sys.exit(1)
+
+    clargs = iter(sys.argv[1:])
+
+    fileobj  = None
+    filerig  = None
+    filemdl  = None
+    rays     = 64
+    distance = 0.0
+    shadows  = True
+    jobs     = multiprocessing.cpu_count()
+
+    for arg in clargs:
+        if(arg in ["-h", "--help"]):
+            print("\nUsage: ./bake_light.py -i model.obj -l model.rig -o model_prelit.mdl")
+            print("\nUsage: ./bake_light.py --input model.obj --lights model.rig --output model_prelit.mdl")
+            print("         [--rays 64] [--distance 0] [--no-shadows] [--jobs N]")
+            print("Bake the lights in model.rig and ambient occlusion into the vertex colors")
+            print("of the OBJ model in model.obj, and save it as a prelit binary model.")
+            print("--rays is the number of occlusion rays per vertex (0 turns occlusion off),")
+            print("--distance how far they reach (0 for the bounding sphere radius).")
+            sys.exit(0)
+        elif(arg in ["-i", "--input"]):
+            fileobj = next(clargs, None)
+        elif(arg in ["-l", "--lights"]):
+            filerig = next(clargs, None)
+        elif(arg in ["-o", "--output"]):
+            filemdl = next(clargs, None)
+        elif(arg in ["-r", "--rays", "-d", "--distance", "-j", "--jobs"]):
+            try:
+                value = float(next(clargs, ""))
+            except ValueError:
+                print(f"Error: {arg} must be followed by a number.")
+                sys.exit(1)
+            if(arg in ["-r", "--rays"]):
+                rays = max(0, int(value))
+            elif(arg in ["-d", "--distance"]):
+                distance = value
+            else:
+                jobs = max(1, int(value))
+        elif(arg == "--no-shadows"):
+            shadows = False
+        else:
+            print("Received malformed argument list. Use -h or --help for usage.")
+            sys.exit(1)
+
+    if(not fileobj or not filerig or not filemdl):
+        print("Error: Required files not specified.")
+        sys.exit(1)
+
+    try:
+        vertices, normals, indices = obj_to_mdl.load_obj(fileobj)
+        lights = read_rig(filerig)
+    except Exception as E:
+        print("Exception occured when reading input")
+        print(f" -> {E}")
+        sys.exit(1)
+
+    colors = bake(vertices, normals, indices, lights, rays, distance, shadows, jobs)
+
+    print(f"{fileobj}: baked {len(lights)} lights into {len(vertices)} vertices")
+
+    try:
+        obj_to_mdl.write_mdl(filemdl, vertices, normals, indices, colors, obj_to_mdl.FLAG_PRELIT)
+    except Exception as E:
+        print(f"Exception occured when writing file {filemdl}")
+        print(f" -> {E}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
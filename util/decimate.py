@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+
+# Generates a lower level of detail of a Wavefront OBJ model.
+#
+# Edges are collapsed in order of their quadric error (Garland & Heckbert),
+# always onto one of their two end points so that the texture coordinates and
+# normals of the remaining corners stay meaningful. Collapses that would fold
+# a triangle over are skipped, and open borders are weighted so the outline
+# of the model survives.
+#
+# The output is written as OBJ or, when its name ends in .mdl, baked straight
+# into the binary model format.
+
+import heapq
+import sys
+
+import obj_to_mdl
+
+BORDER_WEIGHT = 1000.0
+
+def sub(a, b):
+    return (a[0] - b[0], a[1] - b[1], a[2] - b[2])
+
+def cross(a, b):
+    return (a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0])
+
+def dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+def face_normal(positions, triangle):
+    a, b, c = (positions[corner[0]] for corner in triangle)
+    return cross(sub(b, a), sub(c, a))
+
+def plane_quadric(n, p, weight):
+    # Quadric of the plane through p with normal n, as the 10 unique
+    # coefficients of the symmetric 4x4 matrix
+    length = dot(n, n) ** 0.5
+    if length == 0.0:
+        return [0.0] * 10
+    a, b, c = (x / length for x in n)
+    d = -(a * p[0] + b * p[1] + c * p[2])
+    return [weight * x for x in (a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d)]
+
+def quadric_error(q, p):
+    x, y, z = p
+    return (q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+            q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+            q[7] * z * z + 2 * q[8] * z + q[9])
+
+def add(q, r):
+    return [a + b for a, b in zip(q, r)]
+
+def decimate(positions, triangles, ratio):
+    """Returns the triangles that are left after collapsing edges until about
+    ratio of the original triangles remain."""
+    triangles = [list(t) for t in triangles]
+    alive     = [True] * len(triangles)
+    around    = [set() for _ in positions]
+    quadrics  = [[0.0] * 10 for _ in positions]
+    edges     = {}
+
+    for t, triangle in enumerate(triangles):
+        n = face_normal(positions, triangle)
+        q = plane_quadric(n, positions[triangle[0][0]], dot(n, n) ** 0.5 / 2)
+        for i in range(3):
+            v = triangle[i][0]
+            w = triangle[(i + 1) % 3][0]
+            around[v].add(t)
+            quadrics[v] = add(quadrics[v], q)
+            edges[(min(v, w), max(v, w))] = edges.get((min(v, w), max(v, w)), 0) + 1
+
+    # Edges with a single triangle are on a border, keep them in place with a
+    # plane through the edge that is perpendicular to the triangle
+    for t, triangle in enumerate(triangles):
+        n = face_normal(positions, triangle)
+        for i in range(3):
+            v = triangle[i][0]
+            w = triangle[(i + 1) % 3][0]
+            if edges[(min(v, w), max(v, w))] == 1:
+                q = plane_quadric(cross(sub(positions[w], positions[v]), n), positions[v], BORDER_WEIGHT)
+                quadrics[v] = add(quadrics[v], q)
+                quadrics[w] = add(quadrics[w], q)
+
+    version = [0] * len(positions)
+    heap    = []
+
+    def push(v, w):
+        q = add(quadrics[v], quadrics[w])
+        cost_v, cost_w = quadric_error(q, positions[v]), quadric_error(q, positions[w])
+        # (cost, removed vertex, kept vertex, versions at the time)
+        if cost_w <= cost_v:
+            heapq.heappush(heap, (cost_w, v, w, version[v], version[w]))
+        else:
+            heapq.heappush(heap, (cost_v, w, v, version[w], version[v]))
+
+    for v, w in edges:
+        push(v, w)
+
+    remaining = sum(1 for t in triangles if len({c[0] for c in t}) == 3)
+    target    = max(1, int(remaining * ratio))
+
+    while remaining > target and heap:
+        cost, v, w, version_v, version_w = heapq.heappop(heap)
+        if version_v != version[v] or version_w != version[w]:
+            continue
+
+        # Refuse to fold any triangle that keeps its area over
+        flips = False
+        for t in around[v]:
+            corners = [c[0] for c in triangles[t]]
+            if w in corners:
+                continue
+            moved = [(w, None, None) if c == v else (c, None, None) for c in corners]
+            if dot(face_normal(positions, triangles[t]), face_normal(positions, moved)) <= 0.0:
+                flips = True
+                break
+        if flips:
+            continue
+
+        # Corners moving from v to w take over the attributes w has in the
+        # triangles that disappear, unless they lie across a seam
+        attributes = {}
+        for t in around[v]:
+            triangle = triangles[t]
+            if any(c[0] == w for c in triangle):
+                attributes[next(c[1:] for c in triangle if c[0] == v)] = next(c[1:] for c in triangle if c[0] == w)
+
+        for t in list(around[v]):
+            triangle = triangles[t]
+            if any(c[0] == w for c in triangle):
+                alive[t] = False
+                remaining -= 1
+                for c in triangle:
+                    around[c[0]].discard(t)
+            else:
+                triangles[t] = [(w,) + attributes.get(c[1:], c[1:]) if c[0] == v else c for c in triangle]
+                around[w].add(t)
+        around[v].clear()
+
+        quadrics[w] = add(quadrics[w], quadrics[v])
+        version[v] += 1
+        version[w] += 1
+
+        neighbours = {c[0] for t in around[w] for c in triangles[t]} - {w}
+        for n in neighbours:
+            push(w, n)
+
+    return [tuple(t) for t, a in zip(triangles, alive) if a and len({c[0] for c in t}) == 3]
+
+def write_obj(path, positions, uvs, normals, triangles):
+    def corner(c):
+        v, vt, vn = c
+        text = str(v + 1)
+        if vt is not None or vn is not None:
+            text += "/" + (str(vt + 1) if vt is not None else "")
+        if vn is not None:
+            text += "/" + str(vn + 1)
+        return text
+
+    with open(path, "w") as handle:
+        for p in positions:
+            handle.write("v %f %f %f\n" % p)
+        for t in uvs:
+            handle.write("vt %f %f\n" % t)
+        for n in normals:
+            handle.write("vn %f %f %f\n" % n)
+        for triangle in triangles:
+            handle.write("f " + " ".join(corner(c) for c in triangle) + "\n")
+
+def main():
+    if(len(sys.argv) == 1):
+        print("No arguments specified. Use -h or --help for usage.")
+        sys.exit(1)
+
+    clargs = iter(sys.argv[1:])
+
+    filein  = None
+    fileout = None
+    ratio   = 0.5
+
+    for arg in clargs:
+        if(arg in ["-h", "--help"]):
+            print("\nUsage: ./decimate.py -i model.obj -o model_lod1.mdl -r 0.5")
+            print("\nUsage: ./decimate.py --input model.obj --output model_lod1.obj --ratio 0.5")
+            print("Reduce the OBJ model in model.obj to about ratio of its triangles")
+            print("and save it as OBJ, or as a binary model if the output ends in .mdl")
+            sys.exit(0)
+        elif(arg in ["-i", "--input"]):
+            filein = next(clargs, None)
+        elif(arg in ["-o", "--output"]):
+            fileout = next(clargs, None)
+        elif(arg in ["-r", "--ratio"]):
+            try:
+                ratio = float(next(clargs, ""))
+            except ValueError:
+                print("Error: Ratio must be a number.")
+                sys.exit(1)
+        else:
+            print("Received malformed argument list. Use -h or --help for usage.")
+            sys.exit(1)
+
+    if(not filein or not fileout):
+        print("Error: Required files not specified.")
+        sys.exit(1)
+
+    if(ratio <= 0.0 or ratio > 1.0):
+        print("Error: Ratio must be between 0 and 1.")
+        sys.exit(1)
+
+    try:
+        positions, uvs, normals, triangles = obj_to_mdl.read_obj(filein)
+    except Exception as E:
+        print(f"Exception occured when reading file {filein}")
+        print(f" -> {E}")
+        sys.exit(1)
+
+    reduced = decimate(positions, triangles, ratio)
+
+    print(f"{filein}: {len(triangles)} -> {len(reduced)} triangles")
+
+    try:
+        if fileout.endswith(".mdl"):
+            obj_to_mdl.write_mdl(fileout, *obj_to_mdl.build_mesh(positions, uvs, normals, reduced))
+        else:
+            write_obj(fileout, positions, uvs, normals, reduced)
+    except Exception as E:
+        print(f"Exception occured when writing file {fileout}")
+        print(f" -> {E}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,384 @@
+#!/usr/bin/env python3
+
+# Bakes a Wavefront OBJ into the binary model format read by model_load_bin.
+#
+# Layout (little endian, every blob starts on a 32-byte boundary):
+#   header   magic "EMDL", version, vertex/triangle/strip index/strip/cluster
+#            counts, flags, vertex/normal/strip/length/plane/cluster blob
+#            offsets, bounds (AABB min, AABB max, sphere center, sphere radius)
+#   vertices x, y, z, u, v (float) + ARGB color (uint32) -> gfx_vertex_t
+#   normals  x, y, z (float)                             -> vec3_t
+#   strips   uint16, all strips back to back
+#   lengths  uint16, indices in each strip
+#   planes   normal x, y, z, distance (float), one per strip triangle -> mv_plane_t
+#   clusters sphere center x, y, z, radius (float), first strip index, first
+#            strip, strip count (uint32), first vertex, vertex count (uint16)
+#                                                        -> model_cluster_t
+#
+# Identical v/vt/vn triples are merged, polygons are fan triangulated. Corners
+# without a normal get the smooth one model_load_obj gives them. Clusters,
+# strips and planes are built as model_create does at runtime (cluster.c,
+# strip.c), so model_load_bin only has to copy them in.
+
+import collections
+import math
+import struct
+import sys
+
+MAGIC        = 0x4C444D45 # "EMDL"
+VERSION      = 2
+MAX_VERTICES = 65535
+MAX_STRIP    = 65535  # STRIP_MAX_LENGTH in strip.h
+CLUSTER_SIZE = 256    # CONFIG_MODEL_CLUSTER_SIZE in config.h
+FLAG_PRELIT  = 1 << 0 # Vertex colors hold baked lighting
+HEADER       = struct.Struct("<14I10f")
+CLUSTER      = struct.Struct("<4f3I2H")
+
+def align(n):
+    return (n + 31) & ~31
+
+def f32(x):
+    return struct.unpack("<f", struct.pack("<f", x))[0]
+
+def resolve(index, count):
+    # OBJ indices are 1-based, negative ones count back from the end
+    i = int(index)
+    i = i - 1 if i > 0 else count + i
+    if i < 0 or i >= count:
+        raise ValueError(f"index {index} out of range")
+    return i
+
+def read_obj(path):
+    """Returns (positions, uvs, normals, triangles). Every triangle is three
+    (v, vt, vn) corners with 0-based indices, vt and vn may be None."""
+    positions, uvs, normals, triangles = [], [], [], []
+
+    with open(path, "r") as handle:
+        for number, line in enumerate(handle, 1):
+            parts = line.split()
+            if not parts:
+                continue
+            try:
+                if parts[0] == "v":
+                    positions.append(tuple(float(x) for x in parts[1:4]))
+                elif parts[0] == "vt":
+                    uvs.append(tuple(float(x) for x in parts[1:3]))
+                elif parts[0] == "vn":
+                    normals.append(tuple(float(x) for x in parts[1:4]))
+                elif parts[0] == "f":
+                    corners = []
+                    for corner in parts[1:]:
+                        fields = corner.split("/") + ["", ""]
+                        v  = resolve(fields[0], len(positions))
+                        vt = resolve(fields[1], len(uvs))     if fields[1] else None
+                        vn = resolve(fields[2], len(normals)) if fields[2] else None
+                        corners.append((v, vt, vn))
+                    for i in range(1, len(corners) - 1):
+                        triangles.append((corners[0], corners[i], corners[i + 1]))
+            except (ValueError, IndexError) as E:
+                raise ValueError(f"{path}:{number}: malformed line ({E})")
+
+    return positions, uvs, normals, triangles
+
+def smooth_normals(positions, triangles):
+    """Unit normal per position, the area weighted sum of the normals of the
+    triangles using it, as obj_smooth_normals in model.c."""
+    sums = [[0.0, 0.0, 0.0] for _ in positions]
+
+    for triangle in triangles:
+        a, b, c = (positions[corner[0]] for corner in triangle)
+        e = [b[i] - a[i] for i in range(3)]
+        f = [c[i] - a[i] for i in range(3)]
+        n = (e[1] * f[2] - e[2] * f[1], e[2] * f[0] - e[0] * f[2], e[0] * f[1] - e[1] * f[0])
+        for corner in triangle:
+            for i in range(3):
+                sums[corner[0]][i] += n[i]
+
+    smooth = []
+    for n in sums:
+        length = math.sqrt(sum(x * x for x in n))
+        smooth.append(tuple(x / length for x in n) if length > 0.0 else (0.0, 0.0, 0.0))
+
+    return smooth
+
+def build_mesh(positions, uvs, normals, triangles):
+    """Merges identical corners into indexed vertices. Returns (vertices,
+    normals, indices) with vertices as (x, y, z, u, v)."""
+    smooth = None
+    if any(key[2] is None for triangle in triangles for key in triangle):
+        smooth = smooth_normals(positions, triangles)
+
+    lookup = {}
+    out_vertices, out_normals, out_indices = [], [], []
+
+    for triangle in triangles:
+        for key in triangle:
+            if key not in lookup:
+                v, vt, vn = key
+                lookup[key] = len(out_vertices)
+                u, w = uvs[vt] if vt is not None else (0.0, 0.0)
+                out_vertices.append(positions[v] + (u, w))
+                out_normals.append(normals[vn] if vn is not None else smooth[v])
+            out_indices.append(lookup[key])
+
+    if len(out_vertices) > MAX_VERTICES:
+        raise ValueError(f"more than {MAX_VERTICES} unique vertices")
+
+    return out_vertices, out_normals, out_indices
+
+def load_obj(path):
+    """Returns (vertices, normals, indices) with vertices as (x, y, z, u, v)."""
+    return build_mesh(*read_obj(path))
+
+def compute_bounds(vertices):
+    if not vertices:
+        return (0.0,) * 10
+    lo = [min(v[i] for v in vertices) for i in range(3)]
+    hi = [max(v[i] for v in vertices) for i in range(3)]
+    center = [(lo[i] + hi[i]) / 2 for i in range(3)]
+    radius = max(math.sqrt(sum((v[i] - center[i]) ** 2 for i in range(3))) for v in vertices)
+    return tuple(lo + hi + center + [radius])
+
+def build_clusters(indices, vertex_count, max_triangles=CLUSTER_SIZE):
+    """Splits the triangles into culling clusters with vertices of their own,
+    as cluster_build in cluster.c. Returns (vertex_map, cluster_indices,
+    clusters) with clusters as (first vertex, vertex count, first triangle,
+    triangle count) and cluster_indices into vertex_map."""
+    triangle_count = len(indices) // 3
+    if max_triangles == 0 or max_triangles > triangle_count:
+        max_triangles = max(triangle_count, 1)
+
+    around = [[] for _ in range(vertex_count)]
+    for i, v in enumerate(indices):
+        around[v].append(i // 3)
+
+    done, queued = [False] * triangle_count, [0] * triangle_count
+    order, vertex_map, cluster_indices, clusters = [], [], [], []
+    seed, cluster = 0, 0
+
+    while len(order) < triangle_count:
+        cluster += 1
+        start = len(order)
+        queue = collections.deque()
+
+        # Breadth first over triangles sharing a vertex
+        while len(order) - start < max_triangles:
+            if not queue:
+                while seed < triangle_count and done[seed]:
+                    seed += 1
+                if seed >= triangle_count:
+                    break
+                queued[seed] = cluster
+                queue.append(seed)
+
+            t = queue.popleft()
+            order.append(t)
+            done[t] = True
+
+            for v in indices[3 * t:3 * t + 3]:
+                for u in around[v]:
+                    if not done[u] and queued[u] != cluster:
+                        queued[u] = cluster
+                        queue.append(u)
+
+        first_vertex, remap = len(vertex_map), {}
+        for t in order[start:]:
+            for v in indices[3 * t:3 * t + 3]:
+                if v not in remap:
+                    remap[v] = len(vertex_map)
+                    vertex_map.append(v)
+                cluster_indices.append(remap[v])
+
+        clusters.append((first_vertex, len(vertex_map) - first_vertex, start, len(order) - start))
+
+    if len(vertex_map) > MAX_VERTICES:
+        raise ValueError(f"clusters need more than {MAX_VERTICES} vertices")
+
+    return vertex_map, cluster_indices, clusters
+
+def build_strips(triangles):
+    """Greedy stripification of a flat list of triangle indices, as strip_build
+    in strip.c, down to the order of the strips. Returns (indices, lengths)."""
+    triangle_count = len(triangles) // 3
+    used  = [False] * triangle_count
+    stamp = [0] * triangle_count
+    edges = {} # Directed edge -> triangles with it, in order
+
+    for t in range(triangle_count):
+        a, b, c = triangles[3 * t:3 * t + 3]
+        if a == b or b == c or c == a:
+            used[t] = True # Degenerate, nothing to draw
+            continue
+        for edge in ((a, b), (b, c), (c, a)):
+            edges.setdefault(edge, []).append(t)
+
+    def find_next(a, b, trial):
+        for t in edges.get((a, b), ()):
+            if used[t] or stamp[t] == trial:
+                continue
+            v = triangles[3 * t:3 * t + 3]
+            if v[0] == a:
+                return v[2], t
+            if v[1] == a:
+                return v[0], t
+            return v[1], t
+        return None, None
+
+    def grow(t, corner, trial):
+        v = triangles[3 * t:3 * t + 3]
+        strip = [v[corner], v[(corner + 1) % 3], v[(corner + 2) % 3]]
+        claimed = [t]
+        stamp[t] = trial
+
+        while len(strip) < MAX_STRIP:
+            # Odd triangles of a strip are wound the other way
+            a, b = strip[-2], strip[-1]
+            x, u = find_next(a, b, trial) if (len(strip) - 2) % 2 == 0 else find_next(b, a, trial)
+            if x is None:
+                break
+            claimed.append(u)
+            strip.append(x)
+            stamp[u] = trial
+
+        return strip, claimed
+
+    out_indices, out_lengths = [], []
+    trial = 0
+
+    for t in range(triangle_count):
+        if used[t]:
+            continue
+
+        # Try every starting corner and keep the longest strip
+        best_corner, best_length = 0, 0
+        for corner in range(3):
+            trial += 1
+            length = len(grow(t, corner, trial)[0])
+            if length > best_length:
+                best_corner, best_length = corner, length
+
+        trial += 1
+        strip, claimed = grow(t, best_corner, trial)
+        for u in claimed:
+            used[u] = True
+
+        out_indices.extend(strip)
+        out_lengths.append(len(strip))
+
+    return out_indices, out_lengths
+
+def compute_planes(vertices, strips, lengths):
+    """Plane of every strip triangle, (normal x, y, z, distance) with the
+    normal from its winding, left unnormalized as compute_planes in model.c."""
+    planes, first = [], 0
+
+    for length in lengths:
+        for j in range(length - 2):
+            odd = j & 1
+            a = vertices[strips[first + j + (1 if odd else 0)]]
+            b = vertices[strips[first + j + (0 if odd else 1)]]
+            c = vertices[strips[first + j + 2]]
+            e = [b[i] - a[i] for i in range(3)]
+            f = [c[i] - a[i] for i in range(3)]
+            n = (e[1] * f[2] - e[2] * f[1], e[2] * f[0] - e[0] * f[2], e[0] * f[1] - e[1] * f[0])
+            planes.append(n + (-sum(n[i] * a[i] for i in range(3)),))
+        first += length
+
+    return planes
+
+def write_mdl(path, vertices, normals, indices, colors=None, flags=0):
+    """Writes a binary model. colors is an optional list of 0xAARRGGBB,
+    flags a combination of FLAG_*."""
+    if colors is None:
+        colors = [0] * len(vertices)
+
+    # Bounds and planes from the floats the engine will see
+    vertices = [tuple(f32(x) for x in v) for v in vertices]
+
+    vertex_map, cluster_indices, ranges = build_clusters(indices, len(vertices))
+
+    strips, lengths, clusters = [], [], []
+    for first_vertex, vertex_count, first_triangle, triangle_count in ranges:
+        s, l = build_strips(cluster_indices[3 * first_triangle:3 * (first_triangle + triangle_count)])
+        bounds = compute_bounds([vertices[v] for v in vertex_map[first_vertex:first_vertex + vertex_count]])
+        clusters.append(bounds[6:10] + (len(strips), len(lengths), len(l), first_vertex, vertex_count))
+        strips.extend(s)
+        lengths.extend(l)
+
+    vertices = [vertices[v] for v in vertex_map]
+    normals  = [normals[v]  for v in vertex_map]
+    colors   = [colors[v]   for v in vertex_map]
+    planes   = compute_planes(vertices, strips, lengths)
+
+    vertex_offset  = align(HEADER.size)
+    normal_offset  = align(vertex_offset  + 24 * len(vertices))
+    strip_offset   = align(normal_offset  + 12 * len(normals))
+    length_offset  = align(strip_offset   + 2 * len(strips))
+    plane_offset   = align(length_offset  + 2 * len(lengths))
+    cluster_offset = align(plane_offset   + 16 * len(planes))
+    size           = align(cluster_offset + CLUSTER.size * len(clusters))
+
+    data = bytearray(size)
+    HEADER.pack_into(data, 0, MAGIC, VERSION, len(vertices), len(indices) // 3,
+                     len(strips), len(lengths), len(clusters), flags,
+                     vertex_offset, normal_offset, strip_offset, length_offset, plane_offset, cluster_offset,
+                     *compute_bounds(vertices))
+
+    for i, (v, c) in enumerate(zip(vertices, colors)):
+        struct.pack_into("<5fI", data, vertex_offset + 24 * i, *v, c)
+    for i, n in enumerate(normals):
+        struct.pack_into("<3f", data, normal_offset + 12 * i, *n)
+    struct.pack_into(f"<{len(strips)}H", data, strip_offset, *strips)
+    struct.pack_into(f"<{len(lengths)}H", data, length_offset, *lengths)
+    for i, p in enumerate(planes):
+        struct.pack_into("<4f", data, plane_offset + 16 * i, *p)
+    for i, c in enumerate(clusters):
+        CLUSTER.pack_into(data, cluster_offset + CLUSTER.size * i, *c)
+
+    with open(path, "wb") as handle:
+        handle.write(data)
+
+def main():
+    if(len(sys.argv) == 1):
+        print("No arguments specified. Use -h or --help for usage.")
+        sys.exit(1)
+
+    clargs = iter(sys.argv[1:])
+
+    fileobj = None
+    filemdl = None
+
+    for arg in clargs:
+        if(arg in ["-h", "--help"]):
+            print("\nUsage: ./obj_to_mdl.py -i model.obj -o model.mdl")
+            print("\nUsage: ./obj_to_mdl.py --input model.obj --output model.mdl")
+            print("Bake the OBJ model in model.obj into the binary format in model.mdl")
+            sys.exit(0)
+        elif(arg in ["-i", "--input"]):
+            fileobj = next(clargs, None)
+        elif(arg in ["-o", "--output"]):
+            filemdl = next(clargs, None)
+        else:
+            print("Received malformed argument list. Use -h or --help for usage.")
+            sys.exit(1)
+
+    if(not fileobj or not filemdl):
+        print("Error: Required files not specified.")
+        sys.exit(1)
+
+    try:
+        vertices, normals, indices = load_obj(fileobj)
+    except Exception as E:
+        print(f"Exception occured when reading file {fileobj}")
+        print(f" -> {E}")
+        sys.exit(1)
+
+    try:
+        write_mdl(filemdl, vertices, normals, indices)
+    except Exception as E:
+        print(f"Exception occured when writing file {filemdl}")
+        print(f" -> {E}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()